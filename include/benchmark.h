@@ -0,0 +1,71 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_BENCHMARK_H_
+#define WLCS_BENCHMARK_H_
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace wlcs
+{
+/**
+ * A set of duration measurements taken by a benchmark
+ */
+class DurationSamples
+{
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    void add(Duration sample);
+
+    auto count() const -> size_t;
+
+    /**
+     * The smallest sample that at least \p percent % of the samples are less than or equal to
+     *
+     * \throws std::logic_error if there are no samples
+     */
+    auto percentile(double percent) const -> Duration;
+    auto min() const -> Duration;
+    auto max() const -> Duration;
+    auto mean() const -> Duration;
+    /// The population standard deviation; a measure of jitter
+    auto standard_deviation() const -> Duration;
+
+private:
+    std::vector<Duration> mutable samples;
+    bool mutable sorted{true};
+};
+
+/**
+ * Report the distribution of a benchmark's samples
+ *
+ * The count, p50, p95, p99 and max (in microseconds) are recorded as GTest
+ * test properties named "<name>.count", "<name>.p50_us", etc, so they
+ * appear in the --gtest_output=json or xml report, and printed for humans.
+ */
+void report_benchmark(std::string const& name, DurationSamples const& samples);
+
+/**
+ * Report a single benchmark value, as a "<name>.<unit>" test property
+ */
+void report_benchmark(std::string const& name, double value, std::string const& unit);
+}
+
+#endif //WLCS_BENCHMARK_H_
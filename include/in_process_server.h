@@ -30,6 +30,8 @@
 #include <optional>
 #include <unordered_map>
 #include <chrono>
+#include <span>
+#include <vector>
 
 #include "helpers.h"
 #include "wl_handle.h"
@@ -100,6 +102,79 @@ struct WlInterfaceDescriptor<wl_output>
     static constexpr void (* const destructor)(wl_output*) = &send_release_if_supported;
 };
 
+class Touch;
+class InputTimeline;
+
+/**
+ * When an injected input event reached each stage on its way to a client
+ *
+ * The difference between successive stages gives the time spent getting
+ * the event into the display server, handling it in the display server,
+ * and delivering the result to the client.
+ */
+struct InputTiming
+{
+    std::chrono::steady_clock::time_point injected;     ///< wlcs injected the event, with this timestamp
+    std::chrono::steady_clock::time_point dispatched;   ///< The display server's hook was called
+    std::chrono::steady_clock::time_point processed;    ///< The display server's hook returned
+    std::chrono::steady_clock::time_point received;     ///< The client received the resulting event
+};
+
+/**
+ * A timestamped event for Pointer::inject_batch()
+ */
+struct PointerEvent
+{
+    enum class Type
+    {
+        move_to,
+        move_by,
+        button_down,
+        button_up
+    };
+
+    Type type;
+    std::chrono::steady_clock::time_point time;
+    int x{0};       ///< Position for move_to, offset for move_by
+    int y{0};
+    int button{0};
+};
+
+/**
+ * A timestamped event for Touch::inject_batch()
+ */
+struct TouchEvent
+{
+    enum class Type
+    {
+        down,
+        move,
+        up
+    };
+
+    Type type;
+    std::chrono::steady_clock::time_point time;
+    Touch* touch{nullptr};  ///< The touch point to act on; nullptr for the one inject_batch() is called on
+    int x{0};
+    int y{0};
+};
+
+/**
+ * A timestamped event for Keyboard::inject_batch()
+ */
+struct KeyboardEvent
+{
+    enum class Type
+    {
+        key_down,
+        key_up
+    };
+
+    Type type;
+    std::chrono::steady_clock::time_point time;
+    int scancode{0};
+};
+
 class Pointer
 {
 public:
@@ -117,12 +192,26 @@ public:
     void left_button_up();
     void left_click();
 
+    /**
+     * Whether the display server can take a batch of events in a single call
+     */
+    bool supports_batch() const;
+
+    /**
+     * Inject events, in order, as a single burst of input with the given timestamps
+     *
+     * If the display server does not support batched input the events are
+     * injected one at a time and their timestamps are ignored.
+     */
+    void inject_batch(std::span<PointerEvent const> events);
+
 private:
     friend class Server;
     template<typename Proxy>
     Pointer(
         WlcsPointer* raw_device,
         std::shared_ptr<Proxy> const& proxy,
+        std::shared_ptr<InputTimeline> const& timeline,
         std::shared_ptr<void const> const& keep_dso_loaded);
 
     class Impl;
@@ -139,12 +228,28 @@ public:
     void move_to(int x, int y);
     void up();
 
+    /**
+     * Whether the display server can take a batch of events in a single call
+     */
+    bool supports_batch() const;
+
+    /**
+     * Inject events, in order, as a single burst of input with the given timestamps
+     *
+     * Events may be for any Touch created by the same Server, so that a
+     * single batch can describe a multi-finger gesture. If the display
+     * server does not support batched input the events are injected one at
+     * a time and their timestamps are ignored.
+     */
+    void inject_batch(std::span<TouchEvent const> events);
+
 private:
     friend class Server;
     template<typename Proxy>
     Touch(
         WlcsTouch* raw_device,
         std::shared_ptr<Proxy> const& proxy,
+        std::shared_ptr<InputTimeline> const& timeline,
         std::shared_ptr<void const> const& keep_dso_loaded);
 
     class Impl;
@@ -161,12 +266,26 @@ public:
     void key_up(int scancode);
     void key(int scancode);
 
+    /**
+     * Whether the display server can take a batch of events in a single call
+     */
+    bool supports_batch() const;
+
+    /**
+     * Inject events, in order, as a single burst of input with the given timestamps
+     *
+     * If the display server does not support batched input the events are
+     * injected one at a time and their timestamps are ignored.
+     */
+    void inject_batch(std::span<KeyboardEvent const> events);
+
 private:
     friend class Server;
     template<typename Proxy>
     Keyboard(
         WlcsKeyboard* raw_device,
         std::shared_ptr<Proxy> const& proxy,
+        std::shared_ptr<InputTimeline> const& timeline,
         std::shared_ptr<void const> const& keep_dso_loaded);
 
     class Impl;
@@ -195,6 +314,71 @@ public:
     void start();
     void stop();
 
+    /**
+     * Whether the display server supports reset()
+     */
+    bool supports_reset() const;
+
+    /**
+     * Return a started display server to its freshly-started state
+     *
+     * \throws std::logic_error if the display server does not support this
+     */
+    void reset();
+
+    /**
+     * Whether the display server supports advance_frame_clock()
+     */
+    bool supports_frame_clock() const;
+
+    /**
+     * Have the display server complete its next frame now, sending any
+     * pending frame callbacks, rather than at its next vblank
+     *
+     * \throws std::logic_error if the display server does not support this
+     */
+    void advance_frame_clock();
+
+    /**
+     * Whether the display server supports wait_for_idle()
+     */
+    bool supports_wait_for_idle() const;
+
+    /**
+     * Block until the display server has finished processing all queued
+     * input and client requests it has read, and queued the resulting events
+     *
+     * \throws std::logic_error if the display server does not support this
+     */
+    void wait_for_idle();
+
+    /**
+     * Queue input from this server's Pointers, Touches and Keyboards rather
+     * than waiting for the display server to process each event
+     *
+     * Queued input is sent to the display server as a single batch by
+     * flush_input(), or before any other call into the display server. This
+     * avoids a round trip to the display server's thread per event when
+     * injecting many events; it has no effect for display servers which run
+     * on their own thread (WlcsDisplayServer::start).
+     */
+    void begin_input_batch();
+
+    /**
+     * Wait for the display server to process all queued input, and stop queueing
+     */
+    void flush_input();
+
+    /**
+     * When the most recent injected event with a wl_pointer, wl_touch or
+     * wl_keyboard event time of \p event_time reached the display server
+     *
+     * Events are only tracked if the display server accepts timestamps for
+     * injected input, and can only be matched if it uses them as the time of
+     * the events it sends. The received time of the result is unset.
+     */
+    auto injected_input(uint32_t event_time) const -> std::optional<InputTiming>;
+
     std::shared_ptr<const std::unordered_map<std::string, uint32_t>> supported_extensions();
 private:
     class Impl;
@@ -245,6 +429,13 @@ private:
     std::unique_ptr<Impl> impl;
 };
 
+/**
+ * A zero-filled ARGB8888 wl_shm buffer
+ *
+ * Buffers are sub-allocated from a pool of shared memory owned by the
+ * Client, and recycled once destroyed, so creating them is cheap. A buffer
+ * must not outlive its Client.
+ */
 class ShmBuffer
 {
 public:
@@ -305,6 +496,14 @@ public:
     Surface create_xdg_shell_v6_surface(int width, int height);
     Surface create_xdg_shell_stable_surface(int width, int height);
     Surface create_visible_surface(int width, int height);
+    /**
+     * Create \p count visible toplevels of the same size
+     *
+     * This is equivalent to calling create_visible_surface() \p count times,
+     * but sets up every surface before waiting, so it takes one round of
+     * configures and one frame rather than \p count of each.
+     */
+    auto create_visible_surfaces(size_t count, int width, int height) -> std::vector<Surface>;
 
     size_t output_count() const;
     OutputState output_state(size_t index) const;
@@ -322,6 +521,15 @@ public:
     std::optional<uint32_t> latest_serial() const;
     std::optional<KeyEvent> last_key_event() const;
 
+    /**
+     * The timing of the injected input behind the last wl_pointer.motion or
+     * wl_keyboard.key this client received, matched by its event time
+     *
+     * \see Server::injected_input()
+     */
+    std::optional<InputTiming> last_pointer_motion_timing() const;
+    std::optional<InputTiming> last_key_timing() const;
+
     using PointerEnterNotifier =
         std::function<bool(wl_surface*, wl_fixed_t x, wl_fixed_t y)>;
     using PointerLeaveNotifier =
@@ -356,6 +564,16 @@ public:
      */
     void roundtrip();
 
+    /**
+     * Roundtrip, then wait for the display server to finish acting on our
+     * requests and any injected input, and dispatch the resulting events
+     *
+     * With display servers which support Server::wait_for_idle() this
+     * replaces chains of roundtrips hoping the server has settled. With
+     * others it is a single roundtrip().
+     */
+    void roundtrip_until_idle();
+
     /**
      * Perform a `wl_display_flush()`
      *
@@ -369,6 +587,57 @@ public:
      */
     void flush();
 
+    /**
+     * Have the display server complete its next frame now, if it can
+     *
+     * This makes sure the display server has processed all of this client's
+     * requests, then calls Server::advance_frame_clock(). If the display
+     * server does not support that this does nothing, and frame callbacks
+     * arrive at the display server's own pace.
+     */
+    void advance_frame_clock();
+
+private:
+    friend class ShmBuffer;
+
+    class Impl;
+    std::unique_ptr<Impl> const impl;
+};
+
+/**
+ * Dispatch events for many Clients at once
+ *
+ * Client::dispatch_until() and Client::roundtrip() only make progress on one
+ * client, so tests with several clients have to alternate between them.
+ * A Dispatcher waits on all its clients' Wayland sockets in a single epoll
+ * set, dispatching whichever clients have events, until a predicate over all
+ * of them is satisfied.
+ *
+ * Clients must outlive their registration with the Dispatcher.
+ */
+class Dispatcher
+{
+public:
+    Dispatcher();
+    ~Dispatcher();
+
+    void add(Client& client);
+    void remove(Client& client);
+
+    /**
+     * Dispatch events on all clients until \p predicate returns true
+     *
+     * \throws Timeout if \p predicate is not satisfied within \p timeout
+     */
+    void dispatch_until(
+        std::function<bool()> const& predicate,
+        std::chrono::seconds timeout = helpers::a_long_time());
+
+    /**
+     * Perform a `wl_display_roundtrip()` on every client, concurrently
+     */
+    void roundtrip();
+
 private:
     class Impl;
     std::unique_ptr<Impl> const impl;
@@ -401,23 +670,64 @@ public:
     explicit Timeout(char const* message);
 };
 
+/**
+ * Keep a started server running between InProcessServer tests
+ *
+ * When enabled, and the display server supports WlcsDisplayServer::reset,
+ * the server from one test is reset and handed on to the next rather than
+ * being stopped and destroyed. Tests which construct their fixture with
+ * InProcessServer::ServerInstance::fresh still get a newly created server.
+ *
+ * This must be called before RUN_ALL_TESTS().
+ */
+void enable_server_reuse();
+
+/// How calls are passed to the display server's event loop thread
+enum class ThreadProxyTransport
+{
+    socket,         ///< A SOCK_SEQPACKET socketpair (the default)
+    ring_buffer     ///< A shared-memory ring buffer, woken by an eventfd
+};
+
+/**
+ * Select the transport used to call into display servers which run on a
+ * WLCS-provided event loop (WlcsDisplayServer::start_on_this_thread)
+ *
+ * Both transports behave identically; this exists so their overhead can be
+ * compared. It takes effect for servers created after the call.
+ */
+void set_thread_proxy_transport(ThreadProxyTransport transport);
+
 class InProcessServer : public testing::Test
 {
 public:
+    enum class ServerInstance
+    {
+        reusable,   ///< A reset server from an earlier test is acceptable
+        fresh       ///< This test needs a newly created server instance
+    };
+
     InProcessServer();
+    explicit InProcessServer(ServerInstance instance);
 
     void SetUp() override;
     void TearDown() override;
 
     Server& the_server();
 private:
-    Server server;
+    bool const server_is_started;
+    std::shared_ptr<Server> const server;
 };
 
 class StartedInProcessServer : public InProcessServer
 {
 public:
     StartedInProcessServer() { InProcessServer::SetUp(); }
+    explicit StartedInProcessServer(ServerInstance instance)
+        : InProcessServer{instance}
+    {
+        InProcessServer::SetUp();
+    }
     ~StartedInProcessServer() { InProcessServer::TearDown(); }
 
     void SetUp() override {}
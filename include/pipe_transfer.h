@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_PIPE_TRANSFER_H_
+#define WLCS_PIPE_TRANSFER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace wlcs
+{
+/**
+ * An Adler-32 checksum of a byte stream, fed a chunk at a time
+ */
+class StreamChecksum
+{
+public:
+    void update(std::span<std::byte const> data);
+    auto value() const -> uint32_t;
+
+private:
+    uint32_t a{1};
+    uint32_t b{0};
+};
+
+/**
+ * A payload for the data transfer protocols (wl_data_device, primary
+ * selection, data control...) with known content
+ *
+ * The content is a pseudo-random block of up to 1 MiB, held in a memfd and
+ * repeated to make up the size, so even a 1 GiB payload costs little memory.
+ */
+class TransferPayload
+{
+public:
+    explicit TransferPayload(size_t size, uint32_t seed = 0);
+    ~TransferPayload();
+
+    TransferPayload(TransferPayload const&) = delete;
+    auto operator=(TransferPayload const&) -> TransferPayload& = delete;
+
+    auto size() const -> size_t;
+
+    /// The StreamChecksum of the whole payload
+    auto checksum() const -> uint32_t;
+
+    /**
+     * Write the whole payload to \p fd, and close it
+     *
+     * The content is spliced from the memfd (or, if \p fd is not a pipe, sent
+     * with sendfile()), so never passes through user space. \p fd is made
+     * non-blocking, and we wait for it to be writable with epoll.
+     *
+     * Safe to call from several threads at once, with different fds.
+     *
+     * \throws std::system_error if writing fails, eg: the reader has gone away
+     * \throws wlcs::Timeout if \p fd is not writable for helpers::a_long_time()
+     */
+    void send_to(int fd) const;
+
+private:
+    size_t const total_size;
+    size_t const block_size;
+    int const block;
+    uint32_t total_checksum;
+};
+
+struct ReceivedTransfer
+{
+    size_t bytes{0};
+    /// The StreamChecksum of what was read, if we were asked to verify it
+    std::optional<uint32_t> checksum;
+    std::optional<std::chrono::steady_clock::time_point> first_byte;
+    std::chrono::steady_clock::time_point end;
+};
+
+/**
+ * Read \p fd until the writer closes it, and close it
+ *
+ * With \p verify the content is read in chunks and checksummed, rather than
+ * buffered; without, a pipe is spliced to /dev/null, so its content never
+ * leaves the kernel.
+ *
+ * \throws std::system_error if reading fails
+ * \throws wlcs::Timeout if nothing arrives for helpers::a_long_time()
+ */
+auto receive_transfer(int fd, bool verify = true) -> ReceivedTransfer;
+}
+
+#endif //WLCS_PIPE_TRANSFER_H_
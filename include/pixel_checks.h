@@ -0,0 +1,99 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_PIXEL_CHECKS_H_
+#define WLCS_PIXEL_CHECKS_H_
+
+#include "geometry/rectangle.h"
+#include "geometry/size.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace wlcs
+{
+enum class PixelFormat
+{
+    argb8888,
+    xrgb8888    ///< The top byte of each pixel is undefined, and ignored
+};
+
+/**
+ * A view of an image of 32-bit pixels, such as the contents of a ShmBuffer
+ * or a captured frame
+ *
+ * Pixels are the little-endian words wl_shm defines, so a pixel's value is
+ * 0xAARRGGBB whatever the host's byte order.
+ */
+struct PixelView
+{
+    /// A view of tightly packed rows
+    PixelView(std::span<std::byte const> pixels, Size size, PixelFormat format = PixelFormat::argb8888);
+
+    /**
+     * \param stride    bytes from the start of one row to the start of the next
+     * \throws std::invalid_argument if \p pixels is too small for \p size and \p stride
+     */
+    PixelView(std::span<std::byte const> pixels, Size size, int stride, PixelFormat format);
+
+    /**
+     * The pixels within \p region
+     *
+     * \throws std::invalid_argument if \p region is not within the view
+     */
+    auto sub_view(Rectangle const& region) const -> PixelView;
+
+    std::span<std::byte const> pixels;
+    Size size;
+    int stride;
+    PixelFormat format;
+};
+
+/**
+ * Whether every pixel of \p image is \p colour, ignoring alpha for xrgb8888
+ */
+auto is_solid_fill(PixelView const& image, uint32_t colour) -> bool;
+
+/**
+ * Whether \p a and \p b are the same size, and no channel of any pixel
+ * differs by more than \p tolerance
+ *
+ * Alpha is ignored if either is xrgb8888.
+ */
+auto pixels_match(PixelView const& a, PixelView const& b, uint8_t tolerance = 0) -> bool;
+
+struct ChannelHistograms
+{
+    std::array<uint32_t, 256> alpha{};  ///< All zero for xrgb8888
+    std::array<uint32_t, 256> red{};
+    std::array<uint32_t, 256> green{};
+    std::array<uint32_t, 256> blue{};
+};
+
+auto channel_histograms(PixelView const& image) -> ChannelHistograms;
+
+/**
+ * A checksum of the pixels of \p image, ignoring alpha for xrgb8888
+ *
+ * Images with the same size and pixels have the same checksum whatever
+ * their stride, and whichever kernel computed it.
+ */
+auto pixel_checksum(PixelView const& image) -> uint64_t;
+}
+
+#endif //WLCS_PIXEL_CHECKS_H_
@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_PIXEL_KERNELS_H_
+#define WLCS_PIXEL_KERNELS_H_
+
+#include "pixel_checks.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * The per-row kernels behind the pixel checks, so every implementation can
+ * be tested against the others; tests should otherwise use pixel_checks.h
+ */
+namespace wlcs
+{
+/**
+ * The running sums of pixel_checksum(), with pixels summed side by side in
+ * count lanes
+ */
+struct ChecksumLanes
+{
+    static constexpr size_t count = 8;
+
+    std::array<uint32_t, count> a{};
+    std::array<uint32_t, count> b{};
+};
+
+/**
+ * An implementation of the pixel checks, each kernel handling one row of
+ * count pixels
+ *
+ * Every implementation gives the same results, only faster on CPUs which
+ * support it.
+ */
+struct PixelKernels
+{
+    char const* name;
+    bool (*row_is_solid)(std::byte const* row, size_t count, uint32_t colour, uint32_t mask);
+    bool (*rows_match)(std::byte const* a, std::byte const* b, size_t count, uint32_t mask, uint8_t tolerance);
+    void (*row_checksum)(std::byte const* row, size_t count, uint32_t mask, ChecksumLanes& lanes);
+};
+
+/**
+ * Every implementation this CPU supports, from the scalar reference to the
+ * fastest, which the pixel checks use
+ */
+auto supported_pixel_kernels() -> std::vector<PixelKernels const*>;
+
+/// \copydoc is_solid_fill(PixelView const&, uint32_t)
+auto is_solid_fill(PixelView const& image, uint32_t colour, PixelKernels const& kernels) -> bool;
+
+/// \copydoc pixels_match(PixelView const&, PixelView const&, uint8_t)
+auto pixels_match(PixelView const& a, PixelView const& b, uint8_t tolerance, PixelKernels const& kernels) -> bool;
+
+/// \copydoc pixel_checksum(PixelView const&)
+auto pixel_checksum(PixelView const& image, PixelKernels const& kernels) -> uint64_t;
+}
+
+#endif //WLCS_PIXEL_KERNELS_H_
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_SESSION_REPLAY_H_
+#define WLCS_SESSION_REPLAY_H_
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace wlcs
+{
+class Server;
+
+/**
+ * Record the protocol session of each Client created from now on to its
+ * own file in \p directory, or stop recording if \p directory is empty
+ *
+ * Files are named after the running test, and end in ".wlsession". Each
+ * appears once its client has disconnected and the recording is complete.
+ */
+void record_sessions_to(std::optional<std::string> const& directory);
+auto session_recording_directory() -> std::optional<std::string>;
+
+/**
+ * The directory of recorded sessions to replay, as passed to --replay-sessions
+ */
+void set_sessions_to_replay(std::optional<std::string> const& directory);
+auto sessions_to_replay() -> std::optional<std::string>;
+
+enum class ReplayPacing
+{
+    flat_out,       ///< Send each request as soon as the compositor has caught up with the events that preceded it
+    as_recorded     ///< Send each request at the same offset from the start as it was recorded
+};
+
+struct ReplayResult
+{
+    uint64_t requests{0};       ///< Messages sent to the compositor
+    uint64_t request_bytes{0};
+    uint64_t event_bytes{0};    ///< Received from the compositor
+    /// From sending the first request to the compositor closing the connection
+    std::chrono::nanoseconds elapsed{0};
+};
+
+/**
+ * Send the requests of a recorded session to \p server over a new connection
+ *
+ * Each request is held back until the compositor has sent as many
+ * wl_display.delete_id events as the client had received when it sent the
+ * request, as the client may be reusing a deleted id. It is also held back,
+ * briefly, until the compositor has sent as many events of any kind, as the
+ * client may have been responding to one of them; but events such as
+ * wl_buffer.release depend on timing, so a replay is not failed for lack of
+ * them.
+ *
+ * The client's fds are replaced by zero-filled memfds of the size the
+ * originals had at the end of the session, and the compositor's events are
+ * read and discarded. Once every request is sent we shut down our end of the
+ * connection, and wait for the compositor to close its end.
+ *
+ * Replay only makes sense against the same compositor, in the same state, as
+ * was recorded; global names and configure serials are sent as recorded.
+ *
+ * \throws std::runtime_error if the file is not a session recording, or the
+ *                            compositor raises a protocol error
+ * \throws wlcs::Timeout if a wl_display.delete_id the client saw never arrives
+ */
+auto replay_session(
+    Server& server,
+    std::string const& filename,
+    ReplayPacing pacing = ReplayPacing::flat_out) -> ReplayResult;
+}
+
+#endif //WLCS_SESSION_REPLAY_H_
@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_SHM_BUFFER_RING_H_
+#define WLCS_SHM_BUFFER_RING_H_
+
+#include "benchmark.h"
+#include "in_process_server.h"
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace wlcs
+{
+/**
+ * A set of ShmBuffers for a benchmark to commit in turn, as fast as the
+ * compositor releases them
+ *
+ * A buffer is busy from when it is acquired until the compositor releases it.
+ */
+class ShmBufferRing
+{
+public:
+    /// Enough buffers that we rarely have to wait for the compositor to release one
+    static constexpr size_t default_size = 3;
+
+    ShmBufferRing(Client& client, int width, int height, size_t size = default_size);
+
+    ShmBufferRing(ShmBufferRing const&) = delete;
+    auto operator=(ShmBufferRing const&) -> ShmBufferRing& = delete;
+
+    auto has_free_buffer() const -> bool;
+
+    /**
+     * Mark a free buffer busy, and return it
+     *
+     * \pre has_free_buffer()
+     */
+    auto acquire() -> ShmBuffer&;
+
+    /**
+     * Dispatch the client until a buffer is free, then acquire() it
+     *
+     * \throws wlcs::Timeout if no buffer is released in time
+     */
+    auto acquire_when_free() -> ShmBuffer&;
+
+    /**
+     * Add the time from now until the compositor releases \p buffer to
+     * \p latencies
+     *
+     * Call this immediately before committing \p buffer.
+     */
+    void time_release(ShmBuffer const& buffer, DurationSamples& latencies);
+
+    /**
+     * Stop timing the release of every buffer still busy
+     *
+     * So a benchmark can start afresh without the releases of buffers it
+     * committed during warmup landing in its samples.
+     */
+    void stop_timing_releases();
+
+private:
+    struct Slot
+    {
+        bool busy{false};
+        std::optional<std::chrono::steady_clock::time_point> committed_at;
+        DurationSamples* latencies{nullptr};
+    };
+
+    auto free_buffer() const -> std::optional<size_t>;
+
+    Client& client;
+    std::vector<ShmBuffer> buffers;
+    std::vector<Slot> slots;
+};
+}
+
+#endif //WLCS_SHM_BUFFER_RING_H_
@@ -69,7 +69,7 @@ struct WlcsIntegrationDescriptor
 /**
  * Maximum version of WlcsDisplayServer this header provides a definition for
  */
-#define WLCS_DISPLAY_SERVER_VERSION 4
+#define WLCS_DISPLAY_SERVER_VERSION 7
 typedef struct WlcsDisplayServer WlcsDisplayServer;
 struct WlcsDisplayServer
 {
@@ -164,6 +164,65 @@ struct WlcsDisplayServer
      * Create a fake keyboard device
      */
     WlcsKeyboard* (*create_keyboard)(WlcsDisplayServer* server);
+
+    /* Added in version 5 */
+    /**
+     * Return a started display server to the state it was in immediately
+     * after start().
+     *
+     * When the server supports this WLCS may (if asked to re-use servers)
+     * keep a single started server running across tests, calling reset
+     * between them rather than stop, destroy_server, create_server and
+     * start.
+     *
+     * By the time this is called all WLCS clients and fake input devices
+     * from the previous test have been destroyed. The implementation should
+     * discard any remaining per-test state (windows, focus, pointer and
+     * keyboard state, and so on), and must not return until the server is
+     * ready to accept new clients.
+     *
+     * \note    This is an optional interface. If it is NULL WLCS will create
+     *          a fresh server for each test.
+     */
+    void (*reset)(WlcsDisplayServer* server);
+
+    /* Added in version 6 */
+    /**
+     * Complete the compositor's next frame now, rather than at the next
+     * (real or emulated) vblank.
+     *
+     * The compositor should immediately present everything that has been
+     * committed so far, then send the wl_surface.frame callbacks and
+     * presentation feedback for that frame. It should otherwise keep its
+     * usual frame pacing; WLCS uses this to avoid waiting for frame
+     * callbacks, not to replace the compositor's clock.
+     *
+     * This must not return until the frame's events have been queued for
+     * sending to clients.
+     *
+     * \note    This is an optional interface. If it is NULL WLCS will wait
+     *          for the compositor's own frame clock.
+     */
+    void (*advance_frame_clock)(WlcsDisplayServer* server);
+
+    /* Added in version 7 */
+    /**
+     * Block until the compositor has finished all the work it has queued.
+     *
+     * This includes processing any input injected through the fake input
+     * devices, any client requests the compositor has already read, and
+     * any layout, focus or configure changes those cause; by the time this
+     * returns every resulting event should have been queued for sending to
+     * clients.
+     *
+     * WLCS uses this to synchronise with the compositor in one call, rather
+     * than guessing how many roundtrips it takes for the compositor to
+     * settle.
+     *
+     * \note    This is an optional interface. If it is NULL WLCS falls back
+     *          to client roundtrips.
+     */
+    void (*wait_for_idle)(WlcsDisplayServer* server);
 };
 
 /**
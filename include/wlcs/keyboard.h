@@ -17,6 +17,8 @@
 #define WLCS_KEYBOARD_H_
 
 #include <wayland-client-core.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,7 +27,24 @@ extern "C" {
 /**
  * Maximum version of WlcsKeyboard this header provides a definition for
  */
-#define WLCS_KEYBOARD_VERSION 1
+#define WLCS_KEYBOARD_VERSION 3
+
+typedef enum WlcsKeyboardEventType
+{
+    WLCS_KEYBOARD_EVENT_KEY_DOWN,   /**< As WlcsKeyboard::key_down */
+    WLCS_KEYBOARD_EVENT_KEY_UP,     /**< As WlcsKeyboard::key_up */
+} WlcsKeyboardEventType;
+
+typedef struct WlcsKeyboardEvent WlcsKeyboardEvent;
+/**
+ * A single event of a batch passed to WlcsKeyboard::inject_batch
+ */
+struct WlcsKeyboardEvent
+{
+    uint32_t type;          /**< A WlcsKeyboardEventType */
+    int64_t timestamp_ns;   /**< When the event happened, in nanoseconds on CLOCK_MONOTONIC */
+    int scancode;           /**< As for key_down and key_up */
+};
 
 typedef struct WlcsKeyboard WlcsKeyboard;
 /**
@@ -55,6 +74,31 @@ struct WlcsKeyboard
      * Destroy this keyboard, freeing any resources.
      */
     void (*destroy)(WlcsKeyboard* keyboard);
+
+    /* Added in version 2 */
+    /**
+     * Inject a sequence of events in a single call
+     *
+     * The compositor should process the events in order, as it would the
+     * equivalent individual calls, but as a single burst of device input:
+     * each event should carry its own timestamp rather than the time the
+     * compositor processes it.
+     *
+     * \param events   An array of count events, in chronological order
+     */
+    void (*inject_batch)(WlcsKeyboard* keyboard, WlcsKeyboardEvent const* events, size_t count);
+
+    /* Added in version 3 */
+    /*
+     * As key_down and key_up, but for an event which happened at timestamp_ns,
+     * in nanoseconds on CLOCK_MONOTONIC.
+     *
+     * The compositor should use this as the time of the event - including the
+     * time field of the wl_keyboard.key event it sends - rather than the time
+     * it processes it.
+     */
+    void (*key_down_at)(WlcsKeyboard* keyboard, int scancode, int64_t timestamp_ns);
+    void (*key_up_at)(WlcsKeyboard* keyboard, int scancode, int64_t timestamp_ns);
 };
 
 #ifdef __cplusplus
@@ -19,6 +19,8 @@
 #define WLCS_POINTER_H_
 
 #include <wayland-client-core.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,7 +29,28 @@ extern "C" {
 /**
  * Maximum version of WlcsPointer this header provides a definition for
  */
-#define WLCS_POINTER_VERSION 1
+#define WLCS_POINTER_VERSION 3
+
+typedef enum WlcsPointerEventType
+{
+    WLCS_POINTER_EVENT_MOVE_ABSOLUTE,   /**< As WlcsPointer::move_absolute */
+    WLCS_POINTER_EVENT_MOVE_RELATIVE,   /**< As WlcsPointer::move_relative */
+    WLCS_POINTER_EVENT_BUTTON_DOWN,     /**< As WlcsPointer::button_down */
+    WLCS_POINTER_EVENT_BUTTON_UP,       /**< As WlcsPointer::button_up */
+} WlcsPointerEventType;
+
+typedef struct WlcsPointerEvent WlcsPointerEvent;
+/**
+ * A single event of a batch passed to WlcsPointer::inject_batch
+ */
+struct WlcsPointerEvent
+{
+    uint32_t type;          /**< A WlcsPointerEventType */
+    int64_t timestamp_ns;   /**< When the event happened, in nanoseconds on CLOCK_MONOTONIC */
+    wl_fixed_t x;           /**< The x position (or dx, for relative motion) of motion events */
+    wl_fixed_t y;           /**< The y position (or dy, for relative motion) of motion events */
+    int button;             /**< The button code of button events */
+};
 
 typedef struct WlcsPointer WlcsPointer;
 /**
@@ -63,6 +86,35 @@ struct WlcsPointer
      * Destroy this pointer, freeing any resources.
      */
     void (*destroy)(WlcsPointer* pointer);
+
+    /* Added in version 2 */
+    /**
+     * Inject a sequence of events in a single call
+     *
+     * The compositor should process the events in order, as it would the
+     * equivalent individual calls, but as a single burst of device input:
+     * each event should carry its own timestamp rather than the time the
+     * compositor processes it, and the compositor may group them into
+     * wl_pointer.frame()s as it would events arriving from real hardware.
+     *
+     * \param events   An array of count events, in chronological order
+     */
+    void (*inject_batch)(WlcsPointer* pointer, WlcsPointerEvent const* events, size_t count);
+
+    /* Added in version 3 */
+    /*
+     * As the functions above, but for an event which happened at timestamp_ns,
+     * in nanoseconds on CLOCK_MONOTONIC.
+     *
+     * The compositor should use this as the time of the event - including the
+     * time field of the wl_pointer events it sends - rather than the time it
+     * processes it, so that wlcs can tell delay in reaching the compositor
+     * apart from delay within it.
+     */
+    void (*move_absolute_at)(WlcsPointer* pointer, wl_fixed_t x, wl_fixed_t y, int64_t timestamp_ns);
+    void (*move_relative_at)(WlcsPointer* pointer, wl_fixed_t dx, wl_fixed_t dy, int64_t timestamp_ns);
+    void (*button_up_at)(WlcsPointer* pointer, int button, int64_t timestamp_ns);
+    void (*button_down_at)(WlcsPointer* pointer, int button, int64_t timestamp_ns);
 };
 
 #ifdef __cplusplus
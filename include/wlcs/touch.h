@@ -19,6 +19,8 @@
 #define WLCS_TOUCH_H_
 
 #include <wayland-client-core.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,9 +29,36 @@ extern "C" {
 /**
  * Maximum version of WlcsTouch this header provides a definition for
  */
-#define WLCS_TOUCH_VERSION 1
+#define WLCS_TOUCH_VERSION 3
 
 typedef struct WlcsTouch WlcsTouch;
+
+typedef enum WlcsTouchEventType
+{
+    WLCS_TOUCH_EVENT_DOWN,  /**< As WlcsTouch::touch_down */
+    WLCS_TOUCH_EVENT_MOVE,  /**< As WlcsTouch::touch_move */
+    WLCS_TOUCH_EVENT_UP,    /**< As WlcsTouch::touch_up */
+} WlcsTouchEventType;
+
+typedef struct WlcsTouchEvent WlcsTouchEvent;
+/**
+ * A single event of a batch passed to WlcsTouch::inject_batch
+ */
+struct WlcsTouchEvent
+{
+    uint32_t type;          /**< A WlcsTouchEventType */
+    int64_t timestamp_ns;   /**< When the event happened, in nanoseconds on CLOCK_MONOTONIC */
+    /**
+     * The touch point this event is for
+     *
+     * This may be any WlcsTouch created by the same WlcsDisplayServer, so
+     * that one batch can describe a multi-finger gesture.
+     */
+    WlcsTouch* touch;
+    wl_fixed_t x;           /**< As for touch_down and touch_move */
+    wl_fixed_t y;           /**< As for touch_down and touch_move */
+};
+
 struct WlcsTouch
 {
     uint32_t version; /**< Version of the struct this instance provides */
@@ -39,6 +68,34 @@ struct WlcsTouch
     void (*touch_up)(WlcsTouch* touch);
 
     void (*destroy)(WlcsTouch* touch);
+
+    /* Added in version 2 */
+    /**
+     * Inject a sequence of events, possibly for several touch points, in a
+     * single call
+     *
+     * The compositor should process the events in order, as it would the
+     * equivalent individual calls, but as a single burst of device input:
+     * each event should carry its own timestamp rather than the time the
+     * compositor processes it, and events for different touch points with
+     * the same timestamp should be sent in a single wl_touch.frame().
+     *
+     * \param events   An array of count events, in chronological order
+     */
+    void (*inject_batch)(WlcsTouch* touch, WlcsTouchEvent const* events, size_t count);
+
+    /* Added in version 3 */
+    /*
+     * As the functions above, but for an event which happened at timestamp_ns,
+     * in nanoseconds on CLOCK_MONOTONIC.
+     *
+     * The compositor should use this as the time of the event - including the
+     * time field of the wl_touch events it sends - rather than the time it
+     * processes it.
+     */
+    void (*touch_down_at)(WlcsTouch* touch, wl_fixed_t x, wl_fixed_t y, int64_t timestamp_ns);
+    void (*touch_move_at)(WlcsTouch* touch, wl_fixed_t x, wl_fixed_t y, int64_t timestamp_ns);
+    void (*touch_up_at)(WlcsTouch* touch, int64_t timestamp_ns);
 };
 
 #ifdef __cplusplus
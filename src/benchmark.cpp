@@ -0,0 +1,131 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <gtest/gtest.h>
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+auto as_microseconds(wlcs::DurationSamples::Duration duration) -> std::string
+{
+    return std::format("{:.3f}", std::chrono::duration<double, std::micro>{duration}.count());
+}
+}
+
+void wlcs::DurationSamples::add(Duration sample)
+{
+    if (!samples.empty() && sample < samples.back())
+    {
+        sorted = false;
+    }
+    samples.push_back(sample);
+}
+
+auto wlcs::DurationSamples::count() const -> size_t
+{
+    return samples.size();
+}
+
+auto wlcs::DurationSamples::percentile(double percent) const -> Duration
+{
+    if (samples.empty())
+    {
+        BOOST_THROW_EXCEPTION((std::logic_error{"No samples to take a percentile of"}));
+    }
+    if (!sorted)
+    {
+        std::sort(samples.begin(), samples.end());
+        sorted = true;
+    }
+
+    // Nearest-rank method
+    auto const rank = static_cast<size_t>(std::ceil(percent / 100 * samples.size()));
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+auto wlcs::DurationSamples::min() const -> Duration
+{
+    return percentile(0);
+}
+
+auto wlcs::DurationSamples::max() const -> Duration
+{
+    return percentile(100);
+}
+
+auto wlcs::DurationSamples::mean() const -> Duration
+{
+    if (samples.empty())
+    {
+        BOOST_THROW_EXCEPTION((std::logic_error{"No samples to take the mean of"}));
+    }
+    return std::accumulate(samples.begin(), samples.end(), Duration{}) / samples.size();
+}
+
+auto wlcs::DurationSamples::standard_deviation() const -> Duration
+{
+    auto const mean_ns = static_cast<double>(mean().count());
+
+    double sum_of_squares{0};
+    for (auto const& sample : samples)
+    {
+        auto const deviation = sample.count() - mean_ns;
+        sum_of_squares += deviation * deviation;
+    }
+    return Duration{static_cast<Duration::rep>(std::sqrt(sum_of_squares / samples.size()))};
+}
+
+void wlcs::report_benchmark(std::string const& name, DurationSamples const& samples)
+{
+    if (samples.count() == 0)
+    {
+        ::testing::Test::RecordProperty(name + ".count", 0);
+        std::cout << "[ BENCHMARK] " << name << ": no samples" << std::endl;
+        return;
+    }
+
+    auto const p50 = as_microseconds(samples.percentile(50));
+    auto const p95 = as_microseconds(samples.percentile(95));
+    auto const p99 = as_microseconds(samples.percentile(99));
+    auto const max = as_microseconds(samples.max());
+
+    ::testing::Test::RecordProperty(name + ".count", static_cast<int>(samples.count()));
+    ::testing::Test::RecordProperty(name + ".p50_us", p50);
+    ::testing::Test::RecordProperty(name + ".p95_us", p95);
+    ::testing::Test::RecordProperty(name + ".p99_us", p99);
+    ::testing::Test::RecordProperty(name + ".max_us", max);
+
+    std::cout
+        << "[ BENCHMARK] " << name << ": " << samples.count() << " samples, "
+        << "p50 " << p50 << "µs, p95 " << p95 << "µs, p99 " << p99 << "µs, max " << max << "µs"
+        << std::endl;
+}
+
+void wlcs::report_benchmark(std::string const& name, double value, std::string const& unit)
+{
+    auto const formatted = std::format("{:.3f}", value);
+    ::testing::Test::RecordProperty(name + "." + unit, formatted);
+    std::cout << "[ BENCHMARK] " << name << ": " << formatted << " " << unit << std::endl;
+}
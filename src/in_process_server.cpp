@@ -17,8 +17,11 @@
  */
 
 #include "in_process_server.h"
+#include "resource_usage.h"
+#include "session_replay.h"
 #include "thread_proxy.h"
 #include "version_specifier.h"
+#include "wire_traffic.h"
 #include "wlcs/display_server.h"
 #include "helpers.h"
 #include "wlcs/keyboard.h"
@@ -37,10 +40,19 @@
 #include <vector>
 #include <algorithm>
 #include <optional>
+#include <list>
 #include <map>
+#include <deque>
+#include <mutex>
+#include <cstring>
 #include <unordered_map>
+#include <atomic>
+#include <format>
 #include <chrono>
+#include <utility>
+#include <fcntl.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <sys/mman.h>
 
 using namespace std::literals::chrono_literals;
@@ -60,6 +72,20 @@ public:
 
 namespace
 {
+wlcs::ThreadProxyTransport thread_proxy_transport{wlcs::ThreadProxyTransport::socket};
+
+auto make_thread_proxy_channel() -> std::unique_ptr<ThreadProxyChannel>
+{
+    switch (thread_proxy_transport)
+    {
+    case wlcs::ThreadProxyTransport::socket:
+        return std::make_unique<SocketChannel>();
+    case wlcs::ThreadProxyTransport::ring_buffer:
+        return std::make_unique<RingBufferChannel>();
+    }
+    BOOST_THROW_EXCEPTION((std::logic_error{"Unknown ThreadProxy transport"}));
+}
+
 auto interface_description_if_valid(wl_interface const* interface) -> std::string
 {
     if (interface)
@@ -112,6 +138,94 @@ wlcs::Timeout::Timeout(char const* message)
 {
 }
 
+namespace
+{
+auto monotonic_ns(std::chrono::steady_clock::time_point time) -> int64_t
+{
+    // std::chrono::steady_clock is CLOCK_MONOTONIC
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+}
+
+/*
+ * Recently injected input events which the display server was given a
+ * timestamp for, so that the events clients receive can be traced back to them
+ */
+class wlcs::InputTimeline
+{
+public:
+    /**
+     * Note an event being injected now
+     *
+     * \returns  The timestamp to pass to the display server
+     */
+    auto inject() -> int64_t
+    {
+        auto const now = std::chrono::steady_clock::now();
+        auto const timestamp = monotonic_ns(now);
+
+        std::lock_guard lock{mutex};
+        if (events.size() == max_events)
+        {
+            events.pop_front();
+        }
+        events.push_back({timestamp, InputTiming{now, {}, {}, {}}});
+        return timestamp;
+    }
+
+    /**
+     * Call \p hook, on the display server's thread, for the event injected at \p timestamp
+     */
+    template<typename Hook>
+    void dispatch(int64_t timestamp, Hook const& hook)
+    {
+        mark(timestamp, &InputTiming::dispatched);
+        hook();
+        mark(timestamp, &InputTiming::processed);
+    }
+
+    auto find(uint32_t event_time) const -> std::optional<InputTiming>
+    {
+        std::lock_guard lock{mutex};
+        for (auto event = events.rbegin(); event != events.rend(); ++event)
+        {
+            // Wayland event times are in milliseconds, and wrap
+            if (static_cast<uint32_t>(event->timestamp / 1'000'000) == event_time)
+            {
+                return event->timing;
+            }
+        }
+        return {};
+    }
+
+private:
+    struct Event
+    {
+        int64_t timestamp;
+        InputTiming timing;
+    };
+
+    void mark(int64_t timestamp, std::chrono::steady_clock::time_point InputTiming::* stage)
+    {
+        auto const now = std::chrono::steady_clock::now();
+
+        std::lock_guard lock{mutex};
+        for (auto event = events.rbegin(); event != events.rend(); ++event)
+        {
+            if (event->timestamp == timestamp)
+            {
+                event->timing.*stage = now;
+                return;
+            }
+        }
+    }
+
+    static size_t const max_events = 1024;
+
+    std::mutex mutable mutex;
+    std::deque<Event> events;
+};
+
 class wlcs::Pointer::Impl
 {
 public:
@@ -119,9 +233,11 @@ public:
     Impl(
         WlcsPointer* raw_device,
         std::shared_ptr<Proxy> const& proxy,
+        std::shared_ptr<InputTimeline> const& timeline,
         std::shared_ptr<void const> const& keep_dso_loaded)
         : keep_dso_loaded{keep_dso_loaded},
-          pointer{raw_device}
+          pointer{raw_device},
+          timeline{timeline}
     {
         setup_thunks(proxy);
     }
@@ -133,44 +249,170 @@ public:
 
     void move_to(int x, int y)
     {
-        move_absolute_thunk(wl_fixed_from_int(x), wl_fixed_from_int(y));
+        if (supports_timestamps())
+        {
+            move_absolute_at_thunk(wl_fixed_from_int(x), wl_fixed_from_int(y), timeline->inject());
+        }
+        else
+        {
+            move_absolute_thunk(wl_fixed_from_int(x), wl_fixed_from_int(y));
+        }
     }
 
     void move_by(int dx, int dy)
     {
-        move_relative_thunk(wl_fixed_from_int(dx), wl_fixed_from_int(dy));
+        if (supports_timestamps())
+        {
+            move_relative_at_thunk(wl_fixed_from_int(dx), wl_fixed_from_int(dy), timeline->inject());
+        }
+        else
+        {
+            move_relative_thunk(wl_fixed_from_int(dx), wl_fixed_from_int(dy));
+        }
     }
 
     void button_down(int button)
     {
-        button_down_thunk(button);
+        if (supports_timestamps())
+        {
+            button_down_at_thunk(button, timeline->inject());
+        }
+        else
+        {
+            button_down_thunk(button);
+        }
     }
 
     void button_up(int button)
     {
-        button_up_thunk(button);
+        if (supports_timestamps())
+        {
+            button_up_at_thunk(button, timeline->inject());
+        }
+        else
+        {
+            button_up_thunk(button);
+        }
+    }
+
+    bool supports_timestamps() const
+    {
+        return pointer->version >= 3 &&
+            pointer->move_absolute_at && pointer->move_relative_at &&
+            pointer->button_down_at && pointer->button_up_at;
+    }
+
+    bool supports_batch() const
+    {
+        return pointer->version >= 2 && pointer->inject_batch;
+    }
+
+    void inject_batch(std::span<PointerEvent const> events)
+    {
+        if (!supports_batch())
+        {
+            for (auto const& event : events)
+            {
+                switch (event.type)
+                {
+                case PointerEvent::Type::move_to:
+                    move_to(event.x, event.y);
+                    break;
+                case PointerEvent::Type::move_by:
+                    move_by(event.x, event.y);
+                    break;
+                case PointerEvent::Type::button_down:
+                    button_down(event.button);
+                    break;
+                case PointerEvent::Type::button_up:
+                    button_up(event.button);
+                    break;
+                }
+            }
+            return;
+        }
+
+        std::vector<WlcsPointerEvent> raw_events;
+        raw_events.reserve(events.size());
+        for (auto const& event : events)
+        {
+            WlcsPointerEvent raw{};
+            raw.timestamp_ns = monotonic_ns(event.time);
+            switch (event.type)
+            {
+            case PointerEvent::Type::move_to:
+                raw.type = WLCS_POINTER_EVENT_MOVE_ABSOLUTE;
+                break;
+            case PointerEvent::Type::move_by:
+                raw.type = WLCS_POINTER_EVENT_MOVE_RELATIVE;
+                break;
+            case PointerEvent::Type::button_down:
+                raw.type = WLCS_POINTER_EVENT_BUTTON_DOWN;
+                break;
+            case PointerEvent::Type::button_up:
+                raw.type = WLCS_POINTER_EVENT_BUTTON_UP;
+                break;
+            }
+            raw.x = wl_fixed_from_int(event.x);
+            raw.y = wl_fixed_from_int(event.y);
+            raw.button = event.button;
+            raw_events.push_back(raw);
+        }
+        // Synchronous, so raw_events outlives the call on the server thread
+        inject_batch_thunk(raw_events.data(), raw_events.size());
     }
 
 private:
     template<typename Proxy>
     void setup_thunks(std::shared_ptr<Proxy> const& proxy)
     {
-        move_absolute_thunk = proxy->register_op(
+        if (supports_batch())
+        {
+            inject_batch_thunk = proxy->register_op(
+                [this](WlcsPointerEvent const* events, size_t count)
+                {
+                    pointer->inject_batch(pointer, events, count);
+                });
+        }
+        if (supports_timestamps())
+        {
+            move_absolute_at_thunk = proxy->register_async_op(
+                [this](wl_fixed_t x, wl_fixed_t y, int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { pointer->move_absolute_at(pointer, x, y, timestamp); });
+                });
+            move_relative_at_thunk = proxy->register_async_op(
+                [this](wl_fixed_t dx, wl_fixed_t dy, int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { pointer->move_relative_at(pointer, dx, dy, timestamp); });
+                });
+            button_down_at_thunk = proxy->register_async_op(
+                [this](int button, int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { pointer->button_down_at(pointer, button, timestamp); });
+                });
+            button_up_at_thunk = proxy->register_async_op(
+                [this](int button, int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { pointer->button_up_at(pointer, button, timestamp); });
+                });
+        }
+        move_absolute_thunk = proxy->register_async_op(
             [this](wl_fixed_t x, wl_fixed_t y)
             {
                 pointer->move_absolute(pointer, x, y);
             });
-        move_relative_thunk = proxy->register_op(
+        move_relative_thunk = proxy->register_async_op(
             [this](wl_fixed_t dx, wl_fixed_t dy)
             {
                 pointer->move_relative(pointer, dx, dy);
             });
-        button_down_thunk = proxy->register_op(
+        button_down_thunk = proxy->register_async_op(
             [this](int button)
             {
                 pointer->button_down(pointer, button);
             });
-        button_up_thunk = proxy->register_op(
+        button_up_thunk = proxy->register_async_op(
             [this](int button)
             {
                 pointer->button_up(pointer, button);
@@ -184,11 +426,17 @@ private:
 
     std::shared_ptr<void const> const keep_dso_loaded;
     WlcsPointer* const pointer;
+    std::shared_ptr<InputTimeline> const timeline;
 
     std::function<void(wl_fixed_t, wl_fixed_t)> move_absolute_thunk;
     std::function<void(wl_fixed_t, wl_fixed_t)> move_relative_thunk;
     std::function<void(int)> button_down_thunk;
     std::function<void(int)> button_up_thunk;
+    std::function<void(WlcsPointerEvent const*, size_t)> inject_batch_thunk;
+    std::function<void(wl_fixed_t, wl_fixed_t, int64_t)> move_absolute_at_thunk;
+    std::function<void(wl_fixed_t, wl_fixed_t, int64_t)> move_relative_at_thunk;
+    std::function<void(int, int64_t)> button_down_at_thunk;
+    std::function<void(int, int64_t)> button_up_at_thunk;
     std::function<void()> destroy_thunk;
 };
 
@@ -199,8 +447,9 @@ template<typename Proxy>
 wlcs::Pointer::Pointer(
     WlcsPointer* raw_device,
     std::shared_ptr<Proxy> const& proxy,
+    std::shared_ptr<InputTimeline> const& timeline,
     std::shared_ptr<void const> const& keep_dso_loaded)
-    : impl{std::make_unique<Impl>(raw_device, proxy, keep_dso_loaded)}
+    : impl{std::make_unique<Impl>(raw_device, proxy, timeline, keep_dso_loaded)}
 {
 }
 
@@ -245,6 +494,16 @@ void wlcs::Pointer::left_click()
     click(BTN_LEFT);
 }
 
+bool wlcs::Pointer::supports_batch() const
+{
+    return impl->supports_batch();
+}
+
+void wlcs::Pointer::inject_batch(std::span<PointerEvent const> events)
+{
+    impl->inject_batch(events);
+}
+
 class wlcs::Touch::Impl
 {
 public:
@@ -252,15 +511,17 @@ public:
     Impl(
         WlcsTouch* raw_device,
         std::shared_ptr<Proxy> const& proxy,
+        std::shared_ptr<InputTimeline> const& timeline,
         std::shared_ptr<void const> const& keep_dso_loaded)
         : keep_dso_loaded{keep_dso_loaded},
-          touch{raw_device, proxy->register_op([](WlcsTouch* raw_device) { raw_device->destroy(raw_device); })}
+          touch{raw_device, proxy->register_op([](WlcsTouch* raw_device) { raw_device->destroy(raw_device); })},
+          timeline{timeline}
     {
-        if (touch->version != WLCS_TOUCH_VERSION)
+        if (touch->version < 1 || touch->version > WLCS_TOUCH_VERSION)
         {
             BOOST_THROW_EXCEPTION((
                 std::runtime_error{
-                    std::string{"Unexpected WlcsTouch version. Expected: "} +
+                    std::string{"Unexpected WlcsTouch version. Expected: 1 to "} +
                     std::to_string(WLCS_TOUCH_VERSION) +
                     " received: " +
                     std::to_string(touch->version)}));
@@ -270,34 +531,142 @@ public:
 
     void down_at(int x, int y)
     {
-        touch->touch_down(touch.get(), x, y);
+        if (supports_timestamps())
+        {
+            touch_down_at_thunk(x, y, timeline->inject());
+        }
+        else
+        {
+            touch_down_thunk(x, y);
+        }
     }
 
     void move_to(int x, int y)
     {
-        touch->touch_move(touch.get(), x, y);
+        if (supports_timestamps())
+        {
+            touch_move_at_thunk(x, y, timeline->inject());
+        }
+        else
+        {
+            touch_move_thunk(x, y);
+        }
     }
 
     void up()
     {
-        touch->touch_up(touch.get());
+        if (supports_timestamps())
+        {
+            touch_up_at_thunk(timeline->inject());
+        }
+        else
+        {
+            touch_up_thunk();
+        }
+    }
+
+    bool supports_timestamps() const
+    {
+        return touch->version >= 3 && touch->touch_down_at && touch->touch_move_at && touch->touch_up_at;
+    }
+
+    bool supports_batch() const
+    {
+        return touch->version >= 2 && touch->inject_batch;
+    }
+
+    void inject_batch(std::span<TouchEvent const> events)
+    {
+        if (!supports_batch())
+        {
+            for (auto const& event : events)
+            {
+                auto& target = event.touch ? *event.touch->impl : *this;
+                switch (event.type)
+                {
+                case TouchEvent::Type::down:
+                    target.down_at(event.x, event.y);
+                    break;
+                case TouchEvent::Type::move:
+                    target.move_to(event.x, event.y);
+                    break;
+                case TouchEvent::Type::up:
+                    target.up();
+                    break;
+                }
+            }
+            return;
+        }
+
+        std::vector<WlcsTouchEvent> raw_events;
+        raw_events.reserve(events.size());
+        for (auto const& event : events)
+        {
+            WlcsTouchEvent raw{};
+            raw.timestamp_ns = monotonic_ns(event.time);
+            switch (event.type)
+            {
+            case TouchEvent::Type::down:
+                raw.type = WLCS_TOUCH_EVENT_DOWN;
+                break;
+            case TouchEvent::Type::move:
+                raw.type = WLCS_TOUCH_EVENT_MOVE;
+                break;
+            case TouchEvent::Type::up:
+                raw.type = WLCS_TOUCH_EVENT_UP;
+                break;
+            }
+            raw.touch = event.touch ? event.touch->impl->touch.get() : touch.get();
+            // Like down_at() and move_to(), pass the coordinates through unconverted
+            raw.x = event.x;
+            raw.y = event.y;
+            raw_events.push_back(raw);
+        }
+        // Synchronous, so raw_events outlives the call on the server thread
+        inject_batch_thunk(raw_events.data(), raw_events.size());
     }
 
 private:
     template<typename Proxy>
     void set_up_thunks(std::shared_ptr<Proxy> const& proxy)
     {
-        touch_down_thunk = proxy->register_op(
+        if (supports_batch())
+        {
+            inject_batch_thunk = proxy->register_op(
+                [this](WlcsTouchEvent const* events, size_t count)
+                {
+                    touch->inject_batch(touch.get(), events, count);
+                });
+        }
+        if (supports_timestamps())
+        {
+            touch_down_at_thunk = proxy->register_async_op(
+                [this](int x, int y, int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { touch->touch_down_at(touch.get(), x, y, timestamp); });
+                });
+            touch_move_at_thunk = proxy->register_async_op(
+                [this](int x, int y, int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { touch->touch_move_at(touch.get(), x, y, timestamp); });
+                });
+            touch_up_at_thunk = proxy->register_async_op(
+                [this](int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { touch->touch_up_at(touch.get(), timestamp); });
+                });
+        }
+        touch_down_thunk = proxy->register_async_op(
             [this](int x, int y)
             {
                 touch->touch_down(touch.get(), x, y);
             });
-        touch_move_thunk = proxy->register_op(
+        touch_move_thunk = proxy->register_async_op(
             [this](int x, int y)
             {
                 touch->touch_move(touch.get(), x, y);
             });
-        touch_up_thunk = proxy->register_op(
+        touch_up_thunk = proxy->register_async_op(
             [this]()
             {
                 touch->touch_up(touch.get());
@@ -306,10 +675,15 @@ private:
 
     std::shared_ptr<void const> const keep_dso_loaded;
     std::unique_ptr<WlcsTouch, std::function<void(WlcsTouch*)>> const touch;
+    std::shared_ptr<InputTimeline> const timeline;
 
     std::function<void(int, int)> touch_down_thunk;
     std::function<void(int, int)> touch_move_thunk;
     std::function<void()> touch_up_thunk;
+    std::function<void(WlcsTouchEvent const*, size_t)> inject_batch_thunk;
+    std::function<void(int, int, int64_t)> touch_down_at_thunk;
+    std::function<void(int, int, int64_t)> touch_move_at_thunk;
+    std::function<void(int64_t)> touch_up_at_thunk;
 };
 
 wlcs::Touch::~Touch() = default;
@@ -319,8 +693,9 @@ template<typename Proxy>
 wlcs::Touch::Touch(
     WlcsTouch* raw_device,
     std::shared_ptr<Proxy> const& proxy,
+    std::shared_ptr<InputTimeline> const& timeline,
     std::shared_ptr<void const> const& keep_dso_loaded)
-    : impl{std::make_unique<Impl>(raw_device, proxy, keep_dso_loaded)}
+    : impl{std::make_unique<Impl>(raw_device, proxy, timeline, keep_dso_loaded)}
 {
 }
 
@@ -339,6 +714,16 @@ void wlcs::Touch::up()
     impl->up();
 }
 
+bool wlcs::Touch::supports_batch() const
+{
+    return impl->supports_batch();
+}
+
+void wlcs::Touch::inject_batch(std::span<TouchEvent const> events)
+{
+    impl->inject_batch(events);
+}
+
 class wlcs::Keyboard::Impl
 {
 public:
@@ -346,6 +731,7 @@ public:
     Impl(
         WlcsKeyboard* raw_device,
         std::shared_ptr<Proxy> const& proxy,
+        std::shared_ptr<InputTimeline> const& timeline,
         std::shared_ptr<void const> const& keep_dso_loaded) :
         keep_dso_loaded{keep_dso_loaded},
         keyboard{
@@ -354,12 +740,13 @@ public:
                 [](WlcsKeyboard* raw_device)
                 {
                     raw_device->destroy(raw_device);
-                })}
+                })},
+        timeline{timeline}
     {
-        if (keyboard->version != WLCS_KEYBOARD_VERSION)
+        if (keyboard->version < 1 || keyboard->version > WLCS_KEYBOARD_VERSION)
         {
             BOOST_THROW_EXCEPTION((std::runtime_error{std::format(
-                "Unexpected WlcsKeyboard version. Expected: {} received: {}",
+                "Unexpected WlcsKeyboard version. Expected: 1 to {} received: {}",
                 WLCS_KEYBOARD_VERSION,
                 keyboard->version)}));
         }
@@ -368,23 +755,103 @@ public:
 
     void key_down(int scancode)
     {
-        key_down_thunk(scancode);
+        if (supports_timestamps())
+        {
+            key_down_at_thunk(scancode, timeline->inject());
+        }
+        else
+        {
+            key_down_thunk(scancode);
+        }
     }
 
     void key_up(int scancode)
     {
-        key_up_thunk(scancode);
+        if (supports_timestamps())
+        {
+            key_up_at_thunk(scancode, timeline->inject());
+        }
+        else
+        {
+            key_up_thunk(scancode);
+        }
+    }
+
+    bool supports_timestamps() const
+    {
+        return keyboard->version >= 3 && keyboard->key_down_at && keyboard->key_up_at;
+    }
+
+    bool supports_batch() const
+    {
+        return keyboard->version >= 2 && keyboard->inject_batch;
+    }
+
+    void inject_batch(std::span<KeyboardEvent const> events)
+    {
+        if (!supports_batch())
+        {
+            for (auto const& event : events)
+            {
+                switch (event.type)
+                {
+                case KeyboardEvent::Type::key_down:
+                    key_down(event.scancode);
+                    break;
+                case KeyboardEvent::Type::key_up:
+                    key_up(event.scancode);
+                    break;
+                }
+            }
+            return;
+        }
+
+        std::vector<WlcsKeyboardEvent> raw_events;
+        raw_events.reserve(events.size());
+        for (auto const& event : events)
+        {
+            WlcsKeyboardEvent raw{};
+            raw.type = event.type == KeyboardEvent::Type::key_down ?
+                WLCS_KEYBOARD_EVENT_KEY_DOWN :
+                WLCS_KEYBOARD_EVENT_KEY_UP;
+            raw.timestamp_ns = monotonic_ns(event.time);
+            raw.scancode = event.scancode;
+            raw_events.push_back(raw);
+        }
+        // Synchronous, so raw_events outlives the call on the server thread
+        inject_batch_thunk(raw_events.data(), raw_events.size());
     }
 
 private:
     template <typename Proxy> void set_up_thunks(std::shared_ptr<Proxy> const& proxy)
     {
-        key_down_thunk = proxy->register_op(
+        if (supports_batch())
+        {
+            inject_batch_thunk = proxy->register_op(
+                [this](WlcsKeyboardEvent const* events, size_t count)
+                {
+                    keyboard->inject_batch(keyboard.get(), events, count);
+                });
+        }
+        if (supports_timestamps())
+        {
+            key_down_at_thunk = proxy->register_async_op(
+                [this](int scancode, int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { keyboard->key_down_at(keyboard.get(), scancode, timestamp); });
+                });
+            key_up_at_thunk = proxy->register_async_op(
+                [this](int scancode, int64_t timestamp)
+                {
+                    timeline->dispatch(timestamp, [&]() { keyboard->key_up_at(keyboard.get(), scancode, timestamp); });
+                });
+        }
+        key_down_thunk = proxy->register_async_op(
             [this](int scancode)
             {
                 keyboard->key_down(keyboard.get(), scancode);
             });
-        key_up_thunk = proxy->register_op(
+        key_up_thunk = proxy->register_async_op(
             [this](int scancode)
             {
                 keyboard->key_up(keyboard.get(), scancode);
@@ -393,9 +860,13 @@ private:
 
     std::shared_ptr<void const> const keep_dso_loaded;
     std::unique_ptr<WlcsKeyboard, std::function<void(WlcsKeyboard*)>> const keyboard;
+    std::shared_ptr<InputTimeline> const timeline;
 
     std::function<void(int)> key_down_thunk;
     std::function<void(int)> key_up_thunk;
+    std::function<void(WlcsKeyboardEvent const*, size_t)> inject_batch_thunk;
+    std::function<void(int, int64_t)> key_down_at_thunk;
+    std::function<void(int, int64_t)> key_up_at_thunk;
 };
 
 wlcs::Keyboard::~Keyboard() = default;
@@ -403,8 +874,11 @@ wlcs::Keyboard::Keyboard(Keyboard&&) = default;
 
 template <typename Proxy>
 wlcs::Keyboard::Keyboard(
-    WlcsKeyboard* raw_device, std::shared_ptr<Proxy> const& proxy, std::shared_ptr<void const> const& keep_dso_loaded) :
-    impl{std::make_unique<Impl>(raw_device, proxy, keep_dso_loaded)}
+    WlcsKeyboard* raw_device,
+    std::shared_ptr<Proxy> const& proxy,
+    std::shared_ptr<InputTimeline> const& timeline,
+    std::shared_ptr<void const> const& keep_dso_loaded) :
+    impl{std::make_unique<Impl>(raw_device, proxy, timeline, keep_dso_loaded)}
 {
 }
 
@@ -424,6 +898,16 @@ void wlcs::Keyboard::key(int scancode)
     key_up(scancode);
 }
 
+bool wlcs::Keyboard::supports_batch() const
+{
+    return impl->supports_batch();
+}
+
+void wlcs::Keyboard::inject_batch(std::span<KeyboardEvent const> events)
+{
+    impl->inject_batch(events);
+}
+
 namespace
 {
 std::shared_ptr<std::unordered_map<std::string, uint32_t> const> extract_supported_extensions(WlcsDisplayServer* server)
@@ -451,6 +935,12 @@ public:
     {
         return handler;
     }
+
+    template<typename Callable>
+    auto register_async_op(Callable handler)
+    {
+        return handler;
+    }
 };
 }
 
@@ -492,7 +982,9 @@ public:
             thread_context->server_thread = std::thread{
                 [this]()
                 {
+                    wlcs::compositor_thread_started();
                     server->start_on_this_thread(server.get(), thread_context->event_loop.get());
+                    wlcs::compositor_thread_exiting();
                 }};
         }
         else
@@ -503,9 +995,69 @@ public:
 
     void stop()
     {
+        flush_input();
         stop_thunk();
     }
 
+    void begin_input_batch()
+    {
+        if (thread_context)
+        {
+            thread_context->proxy->begin_batch();
+        }
+    }
+
+    void flush_input()
+    {
+        if (thread_context)
+        {
+            thread_context->proxy->flush();
+        }
+    }
+
+    bool supports_reset() const
+    {
+        return server->version >= 5 && server->reset;
+    }
+
+    void reset()
+    {
+        if (!supports_reset())
+        {
+            BOOST_THROW_EXCEPTION((std::logic_error{"Display server does not support reset"}));
+        }
+        flush_input();
+        reset_thunk();
+    }
+
+    bool supports_frame_clock() const
+    {
+        return server->version >= 6 && server->advance_frame_clock;
+    }
+
+    void advance_frame_clock()
+    {
+        if (!supports_frame_clock())
+        {
+            BOOST_THROW_EXCEPTION((std::logic_error{"Display server does not support advancing its frame clock"}));
+        }
+        advance_frame_clock_thunk();
+    }
+
+    bool supports_wait_for_idle() const
+    {
+        return server->version >= 7 && server->wait_for_idle;
+    }
+
+    void wait_for_idle()
+    {
+        if (!supports_wait_for_idle())
+        {
+            BOOST_THROW_EXCEPTION((std::logic_error{"Display server does not support waiting for idle"}));
+        }
+        wait_for_idle_thunk();
+    }
+
     int create_client_socket()
     {
         auto fd = create_client_socket_thunk();
@@ -523,11 +1075,11 @@ public:
     {
         if (thread_context)
         {
-            return Pointer{create_pointer_thunk(), thread_context->proxy, hooks};
+            return Pointer{create_pointer_thunk(), thread_context->proxy, input_timeline, hooks};
         }
         else
         {
-            return Pointer{create_pointer_thunk(), std::make_shared<NullProxy>(), hooks};
+            return Pointer{create_pointer_thunk(), std::make_shared<NullProxy>(), input_timeline, hooks};
         }
     }
 
@@ -535,11 +1087,11 @@ public:
     {
         if (thread_context)
         {
-            return Touch{create_touch_thunk(), thread_context->proxy, hooks};
+            return Touch{create_touch_thunk(), thread_context->proxy, input_timeline, hooks};
         }
         else
         {
-            return Touch{create_touch_thunk(), std::make_shared<NullProxy>(), hooks};
+            return Touch{create_touch_thunk(), std::make_shared<NullProxy>(), input_timeline, hooks};
         }
     }
 
@@ -552,20 +1104,31 @@ public:
         }
         if (thread_context)
         {
-            return Keyboard{create_keyboard_thunk(), thread_context->proxy, hooks};
+            return Keyboard{create_keyboard_thunk(), thread_context->proxy, input_timeline, hooks};
         }
         else
         {
-            return Keyboard{create_keyboard_thunk(), std::make_shared<NullProxy>(), hooks};
+            return Keyboard{create_keyboard_thunk(), std::make_shared<NullProxy>(), input_timeline, hooks};
         }
     }
 
+    auto injected_input(uint32_t event_time) const -> std::optional<InputTiming>
+    {
+        return input_timeline->find(event_time);
+    }
+
     void move_surface_to(Surface& surface, int x, int y)
     {
         // Ensure the server knows about the IDs we're about to send...
         surface.owner().roundtrip();
 
         position_window_absolute_thunk(surface.owner(), surface, x, y);
+
+        if (supports_wait_for_idle())
+        {
+            // ...and that it has finished laying the window out at its new position
+            wait_for_idle_thunk();
+        }
     }
 
     WlcsDisplayServer* wlcs_server() const
@@ -583,7 +1146,7 @@ private:
     {
         explicit ThreadContext(std::unique_ptr<struct wl_event_loop, decltype(&wl_event_loop_destroy)> loop)
             : event_loop{std::move(loop)},
-              proxy{std::make_shared<ThreadProxy>(event_loop.get())}
+              proxy{std::make_shared<ThreadProxy>(event_loop.get(), make_thread_proxy_channel())}
         {
         }
         ThreadContext(ThreadContext&&) = default;
@@ -632,6 +1195,7 @@ private:
     std::optional<ThreadContext> thread_context;
     std::shared_ptr<WlcsServerIntegration const> const hooks;
     std::shared_ptr<std::unordered_map<std::string, uint32_t> const> const supported_extensions_;
+    std::shared_ptr<InputTimeline> const input_timeline{std::make_shared<InputTimeline>()};
 
     template<typename Proxy>
     void initialise_thunks(std::shared_ptr<Proxy> proxy)
@@ -656,12 +1220,36 @@ private:
             {
                 return server->create_touch(server.get());
             });
-        if (server->version >= 4)
+        if (supports_reset())
         {
-            create_keyboard_thunk = proxy->register_op(
+            reset_thunk = proxy->register_op(
                 [this]()
                 {
-                    return server->create_keyboard(server.get());
+                    server->reset(server.get());
+                });
+        }
+        if (supports_wait_for_idle())
+        {
+            wait_for_idle_thunk = proxy->register_op(
+                [this]()
+                {
+                    server->wait_for_idle(server.get());
+                });
+        }
+        if (supports_frame_clock())
+        {
+            advance_frame_clock_thunk = proxy->register_op(
+                [this]()
+                {
+                    server->advance_frame_clock(server.get());
+                });
+        }
+        if (server->version >= 4)
+        {
+            create_keyboard_thunk = proxy->register_op(
+                [this]()
+                {
+                    return server->create_keyboard(server.get());
                 });
         }
         position_window_absolute_thunk = proxy->register_op(
@@ -680,6 +1268,9 @@ private:
             });
     }
     std::function<void()> stop_thunk;
+    std::function<void()> reset_thunk;
+    std::function<void()> advance_frame_clock_thunk;
+    std::function<void()> wait_for_idle_thunk;
     std::function<int()> create_client_socket_thunk;
     std::function<WlcsPointer*()> create_pointer_thunk;
     std::function<WlcsTouch*()> create_touch_thunk;
@@ -707,6 +1298,51 @@ void wlcs::Server::stop()
     impl->stop();
 }
 
+bool wlcs::Server::supports_reset() const
+{
+    return impl->supports_reset();
+}
+
+void wlcs::Server::reset()
+{
+    impl->reset();
+}
+
+bool wlcs::Server::supports_frame_clock() const
+{
+    return impl->supports_frame_clock();
+}
+
+void wlcs::Server::advance_frame_clock()
+{
+    impl->advance_frame_clock();
+}
+
+bool wlcs::Server::supports_wait_for_idle() const
+{
+    return impl->supports_wait_for_idle();
+}
+
+void wlcs::Server::wait_for_idle()
+{
+    impl->wait_for_idle();
+}
+
+void wlcs::Server::begin_input_batch()
+{
+    impl->begin_input_batch();
+}
+
+void wlcs::Server::flush_input()
+{
+    impl->flush_input();
+}
+
+auto wlcs::Server::injected_input(uint32_t event_time) const -> std::optional<InputTiming>
+{
+    return impl->injected_input(event_time);
+}
+
 std::shared_ptr<const std::unordered_map<std::string, uint32_t>> wlcs::Server::supported_extensions()
 {
     return impl->supported_extensions();
@@ -737,24 +1373,99 @@ wlcs::Keyboard wlcs::Server::create_keyboard()
     return impl->create_keyboard();
 }
 
+namespace
+{
+bool server_reuse_enabled{false};
+
+/* The started server left behind by the previous test, if server reuse
+ * is enabled and the display server supports reset()
+ */
+std::shared_ptr<wlcs::Server> warm_server;
+
+class WarmServerEnvironment : public testing::Environment
+{
+public:
+    void TearDown() override
+    {
+        if (warm_server)
+        {
+            warm_server->stop();
+            warm_server.reset();
+        }
+    }
+};
+
+auto acquire_server(wlcs::InProcessServer::ServerInstance instance) -> std::shared_ptr<wlcs::Server>
+{
+    if (auto server = std::move(warm_server))
+    {
+        if (instance == wlcs::InProcessServer::ServerInstance::reusable)
+        {
+            server->reset();
+            return server;
+        }
+        // This test needs a fresh server, so we're done with the warm one.
+        server->stop();
+    }
+    return std::make_shared<wlcs::Server>(
+        wlcs::helpers::get_test_hooks(),
+        wlcs::helpers::get_argc(),
+        wlcs::helpers::get_argv());
+}
+}
+
+void wlcs::enable_server_reuse()
+{
+    if (!server_reuse_enabled)
+    {
+        server_reuse_enabled = true;
+        // GTest takes ownership of the environment
+        testing::AddGlobalTestEnvironment(new WarmServerEnvironment);
+    }
+}
+
+void wlcs::set_thread_proxy_transport(ThreadProxyTransport transport)
+{
+    thread_proxy_transport = transport;
+}
+
 wlcs::InProcessServer::InProcessServer()
-    : server{helpers::get_test_hooks(), helpers::get_argc(), helpers::get_argv()}
+    : InProcessServer{ServerInstance::reusable}
+{
+}
+
+wlcs::InProcessServer::InProcessServer(ServerInstance instance)
+    : server_is_started{warm_server && instance == ServerInstance::reusable},
+      server{acquire_server(instance)}
 {
 }
 
 void wlcs::InProcessServer::SetUp()
 {
-    server.start();
+    if (!server_is_started)
+    {
+        server->start();
+    }
 }
 
 void wlcs::InProcessServer::TearDown()
 {
-    server.stop();
+    if (server_reuse_enabled && server->supports_reset())
+    {
+        /* Leave the server running for the next test; it will be reset
+         * once this test's clients have all been destroyed.
+         */
+        warm_server = server;
+    }
+    else
+    {
+        server->stop();
+    }
 }
 
 wlcs::Server& wlcs::InProcessServer::the_server()
 {
-    return server;
+    return *server;
 }
 
 void throw_wayland_error(wl_display* display)
@@ -778,15 +1489,397 @@ void throw_wayland_error(wl_display* display)
     }
 }
 
+namespace
+{
+/*
+ * The shared memory behind one client's ShmBuffers
+ *
+ * Creating a memfd, mapping it and creating a wl_shm_pool for every buffer is
+ * expensive, so buffers are instead sub-allocated from a few large arenas.
+ * Each arena maps a large range of address space up front and grows its
+ * memfd (and wl_shm_pool) into that range as needed, so growing an arena
+ * never moves the buffers already in it.
+ *
+ * When a ShmBuffer is destroyed its wl_buffer is kept for reuse by the next
+ * ShmBuffer of the same size, once the compositor releases it. The compositor
+ * can only hold a wl_buffer the ShmBuffer has handed out, so one that has
+ * been released since it was last handed out (or never handed out at all) is
+ * idle straight away; otherwise it is idle once the compositor releases it.
+ */
+class ShmPool
+{
+public:
+    struct Buffer
+    {
+        std::function<void()> on_release;
+
+        ShmPool* pool;
+        size_t arena;
+        size_t offset;
+        size_t size;
+        int width;
+        int height;
+        std::byte* data;
+        wl_buffer* buffer;
+        bool owned;     ///< Whether a ShmBuffer currently owns this buffer
+        /// Whether the compositor has released this buffer since its ShmBuffer last handed out the wl_buffer
+        bool released;
+    };
+
+    explicit ShmPool(wl_shm* shm)
+        : shm{shm},
+          page_size{static_cast<size_t>(sysconf(_SC_PAGESIZE))}
+    {
+    }
+
+    ~ShmPool()
+    {
+        for (auto& buffer : buffers)
+        {
+            wl_buffer_destroy(buffer.buffer);
+        }
+        for (auto& arena : arenas)
+        {
+            wl_shm_pool_destroy(arena.pool);
+            munmap(arena.base, arena.reserved);
+            close(arena.fd);
+        }
+    }
+
+    ShmPool(ShmPool const&) = delete;
+    ShmPool& operator=(ShmPool const&) = delete;
+
+    /**
+     * Get a zero-filled buffer, reusing an idle one if possible
+     */
+    auto acquire(int width, int height) -> Buffer&
+    {
+        auto const recycled = idle.find(std::make_pair(width, height));
+        if (recycled != idle.end())
+        {
+            auto& buffer = *recycled->second;
+            idle.erase(recycled);
+            zero(arenas[buffer.arena], buffer.offset, buffer.size);
+            return hand_out(buffer);
+        }
+
+        auto const stride = width * 4;
+        auto const size = round_to_pages(static_cast<size_t>(stride) * height);
+        auto const [arena, offset] = allocate(size);
+
+        auto& buffer = buffers.emplace_back(Buffer{
+            {},
+            this,
+            arena,
+            offset,
+            size,
+            width,
+            height,
+            arenas[arena].base + offset,
+            wl_shm_pool_create_buffer(
+                arenas[arena].pool,
+                static_cast<int32_t>(offset),
+                width,
+                height,
+                stride,
+                WL_SHM_FORMAT_ARGB8888),
+            false,
+            false});
+        wl_buffer_add_listener(buffer.buffer, &listener, &buffer);
+        return hand_out(buffer);
+    }
+
+    /**
+     * Take back a buffer from its ShmBuffer
+     */
+    void recycle(Buffer& buffer)
+    {
+        buffer.owned = false;
+        buffer.on_release = {};
+        if (buffer.released)
+        {
+            idle.emplace(std::make_pair(buffer.width, buffer.height), &buffer);
+        }
+        // Otherwise the compositor may still hold it; on_release() makes it idle when it's done
+    }
+
+private:
+    struct Arena
+    {
+        int fd;
+        std::byte* base;
+        size_t reserved;    ///< The size of the address range mapped for this arena
+        size_t size;        ///< The size of the memfd and the wl_shm_pool
+        wl_shm_pool* pool;
+        std::map<size_t, size_t> free;  ///< Maps offset to length of each free (and zero-filled) range
+    };
+
+    // Plenty for typical surfaces, while keeping thousands of clients' reservations affordable
+    static size_t constexpr arena_reservation = 256 * 1024 * 1024;
+    static size_t constexpr initial_arena_size = 1024 * 1024;
+
+    auto round_to_pages(size_t size) const -> size_t
+    {
+        return std::max(page_size, (size + page_size - 1) / page_size * page_size);
+    }
+
+    auto hand_out(Buffer& buffer) -> Buffer&
+    {
+        buffer.owned = true;
+        // Its new ShmBuffer hasn't handed out the wl_buffer yet
+        buffer.released = true;
+        return buffer;
+    }
+
+    auto allocate(size_t size) -> std::pair<size_t, size_t>
+    {
+        if (auto const found = find_free(size))
+        {
+            return *found;
+        }
+
+        // Reclaim the space of buffers nobody is using before growing
+        if (!idle.empty())
+        {
+            for (auto const& [_, buffer] : idle)
+            {
+                wl_buffer_destroy(buffer->buffer);
+                release_range(buffer->arena, buffer->offset, buffer->size);
+            }
+            idle.clear();
+            buffers.remove_if([](Buffer const& buffer) { return !buffer.owned && buffer.released; });
+
+            if (auto const found = find_free(size))
+            {
+                return *found;
+            }
+        }
+
+        for (auto i = 0u; i < arenas.size(); ++i)
+        {
+            if (grow(i, size))
+            {
+                return *find_free(size);
+            }
+        }
+
+        create_arena(std::max(size, arena_reservation));
+        grow(arenas.size() - 1, size);
+        return *find_free(size);
+    }
+
+    auto find_free(size_t size) -> std::optional<std::pair<size_t, size_t>>
+    {
+        for (auto i = 0u; i < arenas.size(); ++i)
+        {
+            auto& free = arenas[i].free;
+            for (auto range = free.begin(); range != free.end(); ++range)
+            {
+                if (range->second >= size)
+                {
+                    auto const [offset, length] = *range;
+                    free.erase(range);
+                    if (length > size)
+                    {
+                        free.emplace(offset + size, length - size);
+                    }
+                    return std::make_pair(i, offset);
+                }
+            }
+        }
+        return {};
+    }
+
+    void release_range(size_t arena, size_t offset, size_t size)
+    {
+        zero(arenas[arena], offset, size);
+        add_free_range(arena, offset, size);
+    }
+
+    void add_free_range(size_t arena, size_t offset, size_t size)
+    {
+        auto& free = arenas[arena].free;
+        auto next = free.lower_bound(offset);
+        if (next != free.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = free.erase(next);
+        }
+        if (next != free.begin())
+        {
+            auto const previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                previous->second += size;
+                return;
+            }
+        }
+        free.emplace(offset, size);
+    }
+
+    /*
+     * Zero a range, handing its pages back to the kernel where the
+     * backing file supports it
+     */
+    static void zero(Arena& arena, size_t offset, size_t size)
+    {
+        if (fallocate(
+                arena.fd,
+                FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                static_cast<off_t>(offset),
+                static_cast<off_t>(size)) < 0)
+        {
+            std::memset(arena.base + offset, 0, size);
+        }
+    }
+
+    void create_arena(size_t reservation)
+    {
+        auto const fd = wlcs::helpers::create_anonymous_file(0);
+        /* Map the whole reservation now; only the part within the file's
+         * current size may be touched, but growing the file then never
+         * needs the mapping to move.
+         */
+        auto const base = mmap(nullptr, reservation, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            close(fd);
+            BOOST_THROW_EXCEPTION((std::system_error{
+                errno,
+                std::system_category(),
+                "Failed to map shm arena"}));
+        }
+        arenas.push_back(Arena{fd, static_cast<std::byte*>(base), reservation, 0, nullptr, {}});
+    }
+
+    /*
+     * Grow an arena enough to fit a free range of at least the given size
+     *
+     * \return  false if the arena's reservation is too small
+     */
+    auto grow(size_t index, size_t size) -> bool
+    {
+        auto& arena = arenas[index];
+
+        // The free range at the end of the arena, if any, counts towards the space needed
+        size_t tail{0};
+        if (!arena.free.empty())
+        {
+            auto const& [offset, length] = *arena.free.rbegin();
+            if (offset + length == arena.size)
+            {
+                tail = length;
+            }
+        }
+
+        auto const needed = arena.size + size - tail;
+        if (needed > arena.reserved)
+        {
+            return false;
+        }
+        auto const new_size = std::min(arena.reserved, std::max({needed, arena.size * 2, initial_arena_size}));
+
+        if (ftruncate(arena.fd, static_cast<off_t>(new_size)) < 0)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{
+                errno,
+                std::system_category(),
+                "Failed to grow shm arena"}));
+        }
+        if (arena.pool)
+        {
+            wl_shm_pool_resize(arena.pool, static_cast<int32_t>(new_size));
+        }
+        else
+        {
+            arena.pool = wl_shm_create_pool(shm, arena.fd, static_cast<int32_t>(new_size));
+        }
+
+        // The newly added part of the file is already zero-filled
+        auto const old_size = arena.size;
+        arena.size = new_size;
+        add_free_range(index, old_size, new_size - old_size);
+        return true;
+    }
+
+    static void on_release(void* ctx, wl_buffer* /*buffer*/)
+    {
+        auto& buffer = *static_cast<Buffer*>(ctx);
+        if (buffer.owned)
+        {
+            buffer.released = true;
+            // The handler may destroy the ShmBuffer, and with it buffer.on_release
+            if (auto const notify = buffer.on_release)
+            {
+                notify();
+            }
+        }
+        else if (!buffer.released)
+        {
+            buffer.released = true;
+            buffer.pool->idle.emplace(std::make_pair(buffer.width, buffer.height), &buffer);
+        }
+    }
+
+    static constexpr wl_buffer_listener listener {
+        &on_release
+    };
+
+    wl_shm* const shm;
+    size_t const page_size;
+    std::vector<Arena> arenas;
+    std::list<Buffer> buffers;
+    std::multimap<std::pair<int, int>, Buffer*> idle;
+};
+}
+
+namespace
+{
+auto relaying_connections() -> bool
+{
+    return wlcs::wire_traffic_counting_enabled() || wlcs::session_recording_directory();
+}
+
+/*
+ * A file in the session recording directory, named after the running test,
+ * unique to the client being created
+ */
+auto next_session_recording() -> std::optional<std::string>
+{
+    static std::atomic<int> clients{0};
+
+    auto const directory = wlcs::session_recording_directory();
+    if (!directory)
+    {
+        return {};
+    }
+
+    std::string test{"no-test"};
+    if (auto const info = ::testing::UnitTest::GetInstance()->current_test_info())
+    {
+        test = std::format("{}.{}", info->test_suite_name(), info->name());
+    }
+    std::ranges::replace(test, '/', '_');
+
+    return std::format("{}/{}-{}.wlsession", *directory, test, clients++);
+}
+}
+
 class wlcs::Client::Impl
 {
 public:
     Impl(Server& server)
-        : supported_extensions{server.supported_extensions()}
+        : server{server},
+          supported_extensions{server.supported_extensions()}
     {
         try
         {
-            display = wl_display_connect_to_fd(server.create_client_socket());
+            auto fd = server.create_client_socket();
+            if (relaying_connections())
+            {
+                fd = relay_client_connection(fd, next_session_recording());
+            }
+            display = wl_display_connect_to_fd(fd);
         }
         catch (ShimNotImplemented const&)
         {
@@ -823,6 +1916,7 @@ public:
         for (auto const& callback: destruction_callbacks)
             callback();
         destruction_callbacks.clear();
+        shm_pool_.reset();
         wl_display_disconnect(display);
     }
 
@@ -851,9 +1945,39 @@ public:
         return seat;
     }
 
-    void run_on_destruction(std::function<void()> callback)
+    void run_on_destruction(std::function<void()> callback)
+    {
+        destruction_callbacks.push_back(callback);
+    }
+
+    void roundtrip_until_idle()
+    {
+        server_roundtrip();
+        if (server.supports_wait_for_idle())
+        {
+            // The server has now read all our requests; wait for it to act on them, then collect the results
+            server.wait_for_idle();
+            server_roundtrip();
+        }
+    }
+
+    void advance_frame_clock()
+    {
+        if (server.supports_frame_clock())
+        {
+            // Make sure the frame includes everything we've committed
+            server_roundtrip();
+            server.advance_frame_clock();
+        }
+    }
+
+    ShmPool& shm_pool()
     {
-        destruction_callbacks.push_back(callback);
+        if (!shm_pool_)
+        {
+            shm_pool_ = std::make_unique<ShmPool>(shm);
+        }
+        return *shm_pool_;
     }
 
     ShmBuffer const& create_buffer(Client& client, int width, int height)
@@ -866,10 +1990,8 @@ public:
         return *buffer;
     }
 
-    Surface create_wl_shell_surface(Client& client, int width, int height)
+    void make_wl_shell_toplevel(Surface& surface)
     {
-        Surface surface{client};
-
         wl_shell_surface * shell_surface = wl_shell_get_shell_surface(the_shell(), surface);
         surface.run_on_destruction([shell_surface]()
             {
@@ -878,16 +2000,21 @@ public:
         wl_shell_surface_set_toplevel(shell_surface);
 
         wl_surface_commit(surface);
+    }
+
+    Surface create_wl_shell_surface(Client& client, int width, int height)
+    {
+        Surface surface{client};
+
+        make_wl_shell_toplevel(surface);
 
         surface.attach_visible_buffer(width, height);
 
         return surface;
     }
 
-    Surface create_xdg_shell_v6_surface(Client& client, int width, int height)
+    void make_xdg_shell_v6_toplevel(Client& client, Surface& surface)
     {
-        Surface surface{client};
-
         auto xdg_surface = std::make_shared<XdgSurfaceV6>(client, surface);
         auto xdg_toplevel = std::make_shared<XdgToplevelV6>(*xdg_surface);
 
@@ -898,6 +2025,13 @@ public:
             });
 
         wl_surface_commit(surface);
+    }
+
+    Surface create_xdg_shell_v6_surface(Client& client, int width, int height)
+    {
+        Surface surface{client};
+
+        make_xdg_shell_v6_toplevel(client, surface);
 
         surface.attach_visible_buffer(width, height);
 
@@ -951,6 +2085,43 @@ public:
         return surface;
     }
 
+    /*
+     * Give surface an xdg_toplevel role, and commit it
+     *
+     * Unlike create_xdg_shell_stable_surface() this doesn't wait for the
+     * initial configure, but acks every configure as it arrives, and
+     * decrements *awaiting_configure on this surface's first.
+     */
+    void make_xdg_shell_stable_toplevel(
+        Client& client,
+        Surface& surface,
+        std::shared_ptr<size_t> const& awaiting_configure)
+    {
+        auto xdg_surface = std::make_shared<XdgSurfaceStable>(client, surface);
+        auto xdg_toplevel = std::make_shared<XdgToplevelStable>(*xdg_surface);
+
+        ON_CALL(*xdg_surface, configure(testing::_))
+            .WillByDefault(
+                [awaiting_configure,
+                 initially_configured = std::make_shared<bool>(false),
+                 xdg_surface = static_cast<struct xdg_surface*>(*xdg_surface)](uint32_t serial)
+                {
+                    xdg_surface_ack_configure(xdg_surface, serial);
+                    if (!std::exchange(*initially_configured, true))
+                    {
+                        --*awaiting_configure;
+                    }
+                });
+
+        surface.run_on_destruction([xdg_surface, xdg_toplevel]() mutable
+            {
+                xdg_toplevel.reset();
+                xdg_surface.reset();
+            });
+
+        wl_surface_commit(surface);
+    }
+
     Surface create_visible_surface(Client& client, int width, int height)
     {
         if (shell)
@@ -971,6 +2142,55 @@ public:
         }
     }
 
+    std::vector<Surface> create_visible_surfaces(Client& client, size_t count, int width, int height)
+    {
+        if (!shell && !xdg_shell_stable && !xdg_shell_v6)
+        {
+            throw std::runtime_error("compositor does not support any known shell protocols");
+        }
+
+        std::vector<Surface> surfaces;
+        surfaces.reserve(count);
+
+        // Give every surface its role before waiting for anything...
+        auto const awaiting_configure = std::make_shared<size_t>(count);
+        for (auto i = 0u; i < count; ++i)
+        {
+            auto& surface = surfaces.emplace_back(client);
+            if (shell)
+            {
+                make_wl_shell_toplevel(surface);
+            }
+            else if (xdg_shell_stable)
+            {
+                make_xdg_shell_stable_toplevel(client, surface, awaiting_configure);
+            }
+            else
+            {
+                make_xdg_shell_v6_toplevel(client, surface);
+            }
+        }
+
+        // ...then wait for all the initial configures at once...
+        if (!shell && xdg_shell_stable)
+        {
+            client.dispatch_until([awaiting_configure]() { return *awaiting_configure == 0; });
+        }
+
+        // ...and likewise for the first frames
+        auto const rendered = std::make_shared<size_t>(0);
+        for (auto& surface : surfaces)
+        {
+            surface.attach_buffer(width, height);
+            surface.add_frame_callback([rendered](auto) { ++*rendered; });
+            wl_surface_commit(surface);
+        }
+        advance_frame_clock();
+        client.dispatch_until([rendered, count]() { return *rendered == count; });
+
+        return surfaces;
+    }
+
     wl_shell* the_shell() const
     {
         if (shell)
@@ -1068,6 +2288,16 @@ public:
         return last_key_event_;
     }
 
+    std::optional<wlcs::InputTiming> last_pointer_motion_timing() const
+    {
+        return input_timing(last_pointer_motion_);
+    }
+
+    std::optional<wlcs::InputTiming> last_key_timing() const
+    {
+        return input_timing(last_key_);
+    }
+
     bool pointer_events_pending() const
     {
         return !pending_buttons.empty() || pending_pointer_location;
@@ -1117,6 +2347,10 @@ public:
             auto const version_to_bind = version.select_version(global->second.version, to_bind.version);
             if (version_to_bind)
             {
+                if (relaying_connections())
+                {
+                    note_interface(to_bind);
+                }
                 auto global_proxy = wl_registry_bind(registry, global->second.id, &to_bind, version_to_bind.value());
                 if (!global_proxy)
                 {
@@ -1360,6 +2594,7 @@ private:
 
         wlcs::KeyEvent event{key, state == WL_KEYBOARD_KEY_STATE_PRESSED, serial, time};
         me->last_key_event_ = event;
+        me->last_key_ = ReceivedInput{time, std::chrono::steady_clock::now()};
     }
 
     static void keyboard_modifiers(void*, wl_keyboard*, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t)
@@ -1426,11 +2661,12 @@ private:
     static void pointer_motion(
         void* ctx,
         wl_pointer* /*pointer*/,
-        uint32_t /*time*/,
+        uint32_t time,
         wl_fixed_t x,
         wl_fixed_t y)
     {
         auto me = static_cast<Impl*>(ctx);
+        me->last_pointer_motion_ = ReceivedInput{time, std::chrono::steady_clock::now()};
 
         if (!me->current_pointer_location && !me->pending_pointer_location)
             FAIL() << "Got wl_pointer.motion when the pointer was not on a surface";
@@ -1708,6 +2944,10 @@ private:
         static auto const safe_bind = []
             (wl_registry* registry, uint32_t name, const wl_interface* iface, uint32_t version)
         {
+            if (relaying_connections())
+            {
+                note_interface(*iface);
+            }
             return wl_registry_bind(registry, name, iface, std::min(version, static_cast<uint32_t>(iface->version)));
         };
 
@@ -1777,6 +3017,7 @@ private:
         &global_removed
     };
 
+    Server& server;
     std::shared_ptr<std::unordered_map<std::string, uint32_t> const> const supported_extensions;
 
     struct wl_display* display;
@@ -1792,6 +3033,7 @@ private:
     struct zxdg_shell_v6* xdg_shell_v6 = nullptr;
     std::vector<std::function<void()>> destruction_callbacks;
     struct xdg_wm_base* xdg_shell_stable = nullptr;
+    std::unique_ptr<ShmPool> shm_pool_;
 
     struct Global
     {
@@ -1822,6 +3064,28 @@ private:
     std::vector<PointerButtonNotifier> button_notifiers;
 
     std::optional<wlcs::KeyEvent> last_key_event_;
+
+    struct ReceivedInput
+    {
+        uint32_t event_time;
+        std::chrono::steady_clock::time_point received;
+    };
+    std::optional<ReceivedInput> last_pointer_motion_;
+    std::optional<ReceivedInput> last_key_;
+
+    auto input_timing(std::optional<ReceivedInput> const& input) const -> std::optional<wlcs::InputTiming>
+    {
+        if (!input)
+        {
+            return {};
+        }
+        auto timing = server.injected_input(input->event_time);
+        if (timing)
+        {
+            timing->received = input->received;
+        }
+        return timing;
+    }
 };
 
 constexpr wl_keyboard_listener wlcs::Client::Impl::keyboard_listener;
@@ -1868,6 +3132,16 @@ void wlcs::Client::run_on_destruction(std::function<void()> callback)
     impl->run_on_destruction(callback);
 }
 
+void wlcs::Client::roundtrip_until_idle()
+{
+    impl->roundtrip_until_idle();
+}
+
+void wlcs::Client::advance_frame_clock()
+{
+    impl->advance_frame_clock();
+}
+
 wlcs::ShmBuffer const& wlcs::Client::create_buffer(int width, int height)
 {
     return impl->create_buffer(*this, width, height);
@@ -1893,6 +3167,11 @@ wlcs::Surface wlcs::Client::create_visible_surface(int width, int height)
     return impl->create_visible_surface(*this, width, height);
 }
 
+auto wlcs::Client::create_visible_surfaces(size_t count, int width, int height) -> std::vector<Surface>
+{
+    return impl->create_visible_surfaces(*this, count, width, height);
+}
+
 size_t wlcs::Client::output_count() const
 {
     return impl->outputs.size();
@@ -1964,6 +3243,16 @@ std::optional<wlcs::KeyEvent> wlcs::Client::last_key_event() const
     return impl->last_key_event();
 }
 
+std::optional<wlcs::InputTiming> wlcs::Client::last_pointer_motion_timing() const
+{
+    return impl->last_pointer_motion_timing();
+}
+
+std::optional<wlcs::InputTiming> wlcs::Client::last_key_timing() const
+{
+    return impl->last_key_timing();
+}
+
 void wlcs::Client::add_pointer_enter_notification(PointerEnterNotifier const& on_enter)
 {
     impl->add_pointer_enter_notification(on_enter);
@@ -2009,32 +3298,217 @@ wl_pointer* wlcs::Client::the_pointer() const
     return impl->the_pointer();
 }
 
-class wlcs::Surface::Impl
+class wlcs::Dispatcher::Impl
 {
 public:
-    Impl(Client& client)
-        : surface_{wl_compositor_create_surface(client.compositor())},
-          owner_{client}
+    Impl()
+        : epoll_fd{epoll_create1(EPOLL_CLOEXEC)}
     {
-        wl_surface_add_listener(surface_, &surface_listener, this);
+        if (epoll_fd < 0)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{
+                errno,
+                std::system_category(),
+                "Failed to create epoll fd"}));
+        }
     }
 
     ~Impl()
     {
-        for (auto i = 0u; i < pending_callbacks.size(); )
+        close(epoll_fd);
+    }
+
+    void add(wl_display* display)
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = display;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wl_display_get_fd(display), &event) < 0)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{
+                errno,
+                std::system_category(),
+                "Failed to add client to dispatcher"}));
+        }
+        displays.push_back(display);
+    }
+
+    void remove(wl_display* display)
+    {
+        auto const found = std::find(displays.begin(), displays.end(), display);
+        if (found == displays.end())
+        {
+            BOOST_THROW_EXCEPTION((std::logic_error{"Client is not registered with this dispatcher"}));
+        }
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, wl_display_get_fd(display), nullptr);
+        displays.erase(found);
+    }
+
+    void dispatch_until(std::function<bool()> const& predicate, std::chrono::seconds timeout)
+    {
+        using namespace std::chrono;
+
+        auto const end_time = steady_clock::now() + timeout;
+        while (!predicate())
         {
-            if (pending_callbacks[i].first == this)
+            /* Every display must be prepared to read before we wait, and then
+             * either read or cancel; see wl_display_prepare_read()
+             */
+            for (auto i = 0u; i < displays.size(); ++i)
             {
-                auto pending_callback = pending_callbacks[i].second;
-                delete static_cast<std::function<void(uint32_t)>*>(wl_callback_get_user_data(pending_callback));
+                while (wl_display_prepare_read(displays[i]) != 0)
+                {
+                    if (wl_display_dispatch_pending(displays[i]) < 0)
+                    {
+                        cancel_reads(i);
+                        throw_wayland_error(displays[i]);
+                    }
+                }
+                wl_display_flush(displays[i]);
+            }
 
-                wl_callback_destroy(pending_callback);
-                pending_callbacks.erase(pending_callbacks.begin() + i);
+            auto const time_left = end_time - steady_clock::now();
+            if (time_left.count() < 0)
+            {
+                cancel_reads();
+                BOOST_THROW_EXCEPTION((Timeout{"Timeout waiting for condition"}));
             }
-            else
+
+            // Round up, so we wait until *after* we're meant to time out
+            auto const maximum_wait_ms = duration_cast<milliseconds>(time_left) + 1ms;
+            ready.resize(std::max<size_t>(displays.size(), 1));
+            auto const ready_count = epoll_wait(epoll_fd, ready.data(), ready.size(), maximum_wait_ms.count());
+            if (ready_count < 0)
+            {
+                auto const error = errno;
+                cancel_reads();
+                BOOST_THROW_EXCEPTION((std::system_error{
+                    error,
+                    std::system_category(),
+                    "Failed to wait for Wayland event"}));
+            }
+            if (ready_count == 0)
+            {
+                cancel_reads();
+                BOOST_THROW_EXCEPTION((Timeout{"Timeout waiting for condition"}));
+            }
+
+            readable.clear();
+            for (auto i = 0; i < ready_count; ++i)
+            {
+                readable.push_back(static_cast<wl_display*>(ready[i].data.ptr));
+            }
+            for (auto const display : displays)
+            {
+                if (std::find(readable.begin(), readable.end(), display) == readable.end())
+                {
+                    wl_display_cancel_read(display);
+                }
+            }
+            for (auto i = 0u; i < readable.size(); ++i)
             {
-                ++i;
+                if (wl_display_read_events(readable[i]) < 0)
+                {
+                    // We've already read or cancelled everything before i
+                    for (auto j = i + 1; j < readable.size(); ++j)
+                    {
+                        wl_display_cancel_read(readable[j]);
+                    }
+                    throw_wayland_error(readable[i]);
+                }
+            }
+            for (auto const display : readable)
+            {
+                if (wl_display_dispatch_pending(display) < 0)
+                {
+                    throw_wayland_error(display);
+                }
+            }
+        }
+    }
+
+    void roundtrip()
+    {
+        static wl_callback_listener const done_listener{
+            [](void* data, wl_callback* callback, uint32_t)
+            {
+                ++*static_cast<size_t*>(data);
+                wl_callback_destroy(callback);
             }
+        };
+
+        size_t done{0};
+        for (auto const display : displays)
+        {
+            wl_callback_add_listener(wl_display_sync(display), &done_listener, &done);
+        }
+        auto const expected = displays.size();
+        dispatch_until([&done, expected]() { return done == expected; }, helpers::a_long_time());
+    }
+
+private:
+    // Cancel the reads prepared on the first \p count displays
+    void cancel_reads(size_t count)
+    {
+        for (auto i = 0u; i < count; ++i)
+        {
+            wl_display_cancel_read(displays[i]);
+        }
+    }
+
+    void cancel_reads()
+    {
+        cancel_reads(displays.size());
+    }
+
+    int const epoll_fd;
+    std::vector<wl_display*> displays;
+    std::vector<epoll_event> ready;
+    std::vector<wl_display*> readable;
+};
+
+wlcs::Dispatcher::Dispatcher()
+    : impl{std::make_unique<Impl>()}
+{
+}
+
+wlcs::Dispatcher::~Dispatcher() = default;
+
+void wlcs::Dispatcher::add(Client& client)
+{
+    impl->add(client);
+}
+
+void wlcs::Dispatcher::remove(Client& client)
+{
+    impl->remove(client);
+}
+
+void wlcs::Dispatcher::dispatch_until(std::function<bool()> const& predicate, std::chrono::seconds timeout)
+{
+    impl->dispatch_until(predicate, timeout);
+}
+
+void wlcs::Dispatcher::roundtrip()
+{
+    impl->roundtrip();
+}
+
+class wlcs::Surface::Impl
+{
+public:
+    Impl(Client& client)
+        : surface_{wl_compositor_create_surface(client.compositor())},
+          owner_{client}
+    {
+        wl_surface_add_listener(surface_, &surface_listener, this);
+    }
+
+    ~Impl()
+    {
+        for (auto const& pending : pending_callbacks)
+        {
+            wl_callback_destroy(pending.callback);
         }
 
         for (auto const& callback: destruction_callbacks)
@@ -2051,20 +3525,17 @@ public:
 
     void attach_buffer(int width, int height)
     {
-        auto& buffer = owner_.create_buffer(width, height);
+        // Once the compositor releases the buffer the Client's pool will reuse it
+        ShmBuffer buffer{owner_, width, height};
         wl_surface_attach(surface_, buffer, 0, 0);
     }
 
     void add_frame_callback(std::function<void(uint32_t)> const& on_frame)
     {
-        std::unique_ptr<std::function<void(uint32_t)>> holder{
-            new std::function<void(uint32_t)>(on_frame)};
-
-        auto callback = wl_surface_frame(surface_);
-
-        pending_callbacks.push_back(std::make_pair(this, callback));
+        auto& pending = pending_callbacks.emplace_back(this, wl_surface_frame(surface_), on_frame);
+        pending.position = std::prev(pending_callbacks.end());
 
-        wl_callback_add_listener(callback, &frame_listener, holder.release());
+        wl_callback_add_listener(pending.callback, &frame_listener, &pending);
     }
 
     void attach_visible_buffer(int width, int height)
@@ -2073,6 +3544,7 @@ public:
         auto surface_rendered = std::make_shared<bool>(false);
         add_frame_callback([surface_rendered](auto) { *surface_rendered = true; });
         wl_surface_commit(surface_);
+        owner_.advance_frame_clock();
         owner_.dispatch_until([surface_rendered]() { return *surface_rendered; });
     }
 
@@ -2093,26 +3565,41 @@ public:
 
 private:
 
-    static std::vector<std::pair<Impl const*, wl_callback*>> pending_callbacks;
+    /*
+     * A frame callback this surface is waiting on
+     *
+     * The wl_callback's user data points at its PendingCallback, which knows
+     * its own position in the surface's list, so completing one doesn't
+     * involve searching for it.
+     */
+    struct PendingCallback
+    {
+        PendingCallback(Impl* surface, wl_callback* callback, std::function<void(uint32_t)> const& on_frame)
+            : surface{surface},
+              callback{callback},
+              on_frame{on_frame}
+        {
+        }
+
+        Impl* const surface;
+        wl_callback* const callback;
+        std::function<void(uint32_t)> on_frame;
+        std::list<PendingCallback>::iterator position;
+    };
+
+    std::list<PendingCallback> pending_callbacks;
     std::set<wl_output*> outputs;
 
     static void frame_callback(void* ctx, wl_callback* callback, uint32_t frame_time)
     {
-        auto us = std::find_if(
-            pending_callbacks.begin(),
-            pending_callbacks.end(),
-            [callback](auto const& elem)
-            {
-                return elem.second == callback;
-            });
-        pending_callbacks.erase(us);
-
-        auto frame_callback = static_cast<std::function<void(uint32_t)>*>(ctx);
-
-        (*frame_callback)(frame_time);
+        auto const pending = static_cast<PendingCallback*>(ctx);
 
+        // on_frame may destroy the surface, so we must be done with it first
+        auto const on_frame = std::move(pending->on_frame);
+        pending->surface->pending_callbacks.erase(pending->position);
         wl_callback_destroy(callback);
-        delete frame_callback;
+
+        on_frame(frame_time);
     }
 
     static constexpr wl_callback_listener frame_listener = {
@@ -2169,8 +3656,6 @@ private:
     std::vector<std::function<void()>> destruction_callbacks;
 };
 
-std::vector<std::pair<wlcs::Surface::Impl const*, wl_callback*>> wlcs::Surface::Impl::pending_callbacks;
-
 constexpr wl_callback_listener wlcs::Surface::Impl::frame_listener;
 constexpr wl_surface_listener wlcs::Surface::Impl::surface_listener;
 
@@ -2283,55 +3768,33 @@ wlcs::Surface& wlcs::Subsurface::parent() const
 class wlcs::ShmBuffer::Impl
 {
 public:
-    Impl(Client& client, int width, int height)
+    Impl(ShmPool& pool, int width, int height)
+        : pool{pool},
+          slot{pool.acquire(width, height)}
     {
-        auto stride = width * 4;
-        size = stride * height;
-        auto fd = wlcs::helpers::create_anonymous_file(size);
-        data_ = static_cast<std::byte*>(
-            mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0));
-        if (data_ == MAP_FAILED)
-        {
-            close(fd);
-            BOOST_THROW_EXCEPTION((std::system_error{
-                errno,
-                std::system_category(),
-                "Failed to map buffer"}));
-        }
-
-        auto pool = wl_shm_create_pool(client.shm(), fd, size);
-        buffer_ = wl_shm_pool_create_buffer(
-            pool,
-            0,
-            width,
-            height,
-            stride,
-            WL_SHM_FORMAT_ARGB8888);
-        wl_shm_pool_destroy(pool);
-        close(fd);
-
-        wl_buffer_add_listener(buffer_, &listener, this);
+        slot.on_release = [this]() { on_release(); };
     }
 
     ~Impl()
     {
-        wl_buffer_destroy(buffer_);
-        munmap(data_, size);
+        pool.recycle(slot);
     }
 
     wl_buffer* buffer() const
     {
-        return buffer_;
+        // The compositor may hold it from now until it next releases it
+        slot.released = false;
+        return slot.buffer;
     }
 
     std::span<std::byte> data()
     {
-        return {data_, static_cast<size_t>(size)};
+        return {slot.data, size()};
     }
 
     std::span<std::byte const> data() const
     {
-        return {data_, static_cast<size_t>(size)};
+        return {slot.data, size()};
     }
 
     void add_release_listener(std::function<bool()> const& on_release)
@@ -2340,13 +3803,17 @@ public:
     }
 
 private:
-    static void on_release(void* ctx, wl_buffer* /*buffer*/)
+    // The pool rounds allocations up to whole pages; that padding isn't part of the buffer
+    auto size() const -> size_t
     {
-        auto me = static_cast<Impl*>(ctx);
+        return static_cast<size_t>(slot.width) * 4 * slot.height;
+    }
 
-        std::vector<decltype(me->release_notifiers.begin())> expired_notifiers;
+    void on_release()
+    {
+        std::vector<decltype(release_notifiers.begin())> expired_notifiers;
 
-        for (auto notifier = me->release_notifiers.begin(); notifier != me->release_notifiers.end(); ++notifier)
+        for (auto notifier = release_notifiers.begin(); notifier != release_notifiers.end(); ++notifier)
         {
             if (!(*notifier)())
             {
@@ -2354,23 +3821,16 @@ private:
             }
         }
         for (auto const& expired : expired_notifiers)
-            me->release_notifiers.erase(expired);
+            release_notifiers.erase(expired);
     }
 
-    static constexpr wl_buffer_listener listener {
-        &on_release
-    };
-
-    int size;
-    std::byte* data_;
-    wl_buffer* buffer_;
+    ShmPool& pool;
+    ShmPool::Buffer& slot;
     std::vector<std::function<bool()>> release_notifiers;
 };
 
-constexpr wl_buffer_listener wlcs::ShmBuffer::Impl::listener;
-
 wlcs::ShmBuffer::ShmBuffer(Client &client, int width, int height)
-    : impl{std::make_unique<Impl>(client, width, height)}
+    : impl{std::make_unique<Impl>(client.impl->shm_pool(), width, height)}
 {
 }
 
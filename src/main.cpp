@@ -19,37 +19,25 @@
 #include <gtest/gtest.h>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
 
 #include <dlfcn.h>
 
 #include "xfail_supporting_test_listener.h"
+#include "parallel_test_runner.h"
 #include "shared_library.h"
 #include "wlcs/display_server.h"
 
 #include "helpers.h"
+#include "in_process_server.h"
+#include "session_replay.h"
+#include "wire_traffic.h"
 
-
-int main(int argc, char** argv)
+namespace
+{
+auto load_integration(char const* integration_filename) -> std::shared_ptr<WlcsServerIntegration const>
 {
-    ::testing::InitGoogleTest(&argc, argv);
-
-    if (argc < 2 || !argv[1] || std::string{"--help"} == argv[1])
-    {
-        std::cerr
-            << "WayLand Conformance Suite test runner" << std::endl
-            << "Usage: " << argv[0] << " COMPOSITOR_INTEGRATION_MODULE [GTEST OPTIONS]... [COMPOSITOR_OPTIONS]..." << std::endl;
-        return 1;
-    }
-
-    auto const integration_filename = argv[1];
-
-    // Shuffle the integration module argument out of argv
-    for (auto i = 1 ; i < (argc - 1) ; ++i)
-    {
-        argv[i] = argv[i + 1];
-    }
-    wlcs::helpers::set_command_line(argc - 1, const_cast<char const**>(argv));
-
     std::shared_ptr<wlcs::SharedLibrary> dso;
     try
     {
@@ -59,13 +47,12 @@ int main(int argc, char** argv)
     {
         std::cerr
             << "Failed to load compositor integration module " << integration_filename << ": " << err.what() << std::endl;
-        return 1;
+        return {};
     }
 
-    std::shared_ptr<WlcsServerIntegration const> entry_point;
     try
     {
-        entry_point = std::shared_ptr<WlcsServerIntegration const>{
+        return std::shared_ptr<WlcsServerIntegration const>{
             dso,
             dso->load_function<WlcsServerIntegration const*>("wlcs_server_integration")
         };
@@ -74,16 +61,60 @@ int main(int argc, char** argv)
     {
         std::cerr
             << "Failed to load compositor entry point: " << err.what() << std::endl;
-        return 1;
+        return {};
+    }
+}
+
+struct Options
+{
+    bool reuse_server;
+    std::optional<std::string> test_report;
+    bool count_wire_traffic;
+    std::optional<std::string> record_sessions;
+    std::optional<std::string> replay_sessions;
+};
+
+auto run_tests(
+    char const* integration_filename,
+    Options const& options,
+    bool print_summary) -> testing::XFailSupportingTestListenerWrapper const*
+{
+    auto const entry_point = load_integration(integration_filename);
+    if (!entry_point)
+    {
+        return nullptr;
     }
 
     wlcs::helpers::set_entry_point(entry_point);
+    if (options.reuse_server)
+    {
+        wlcs::enable_server_reuse();
+    }
+    if (options.count_wire_traffic)
+    {
+        wlcs::enable_wire_traffic_counting();
+    }
+    wlcs::record_sessions_to(options.record_sessions);
+    wlcs::set_sessions_to_replay(options.replay_sessions);
 
     auto& listeners = ::testing::UnitTest::GetInstance()->listeners();
     auto wrapping_listener = new testing::XFailSupportingTestListenerWrapper{
         std::unique_ptr<::testing::TestEventListener>{
-            listeners.Release(listeners.default_result_printer())}};
+            listeners.Release(listeners.default_result_printer())},
+        print_summary};
     listeners.Append(wrapping_listener);
+    if (options.test_report)
+    {
+        try
+        {
+            wrapping_listener->write_test_report_to(*options.test_report);
+        }
+        catch (std::exception const& err)
+        {
+            std::cerr << err.what() << std::endl;
+            return nullptr;
+        }
+    }
 
     /* (void)! is apparently the magical incantation required to get GCC to
      * *actually* silently ignore the return value of a function declared with
@@ -91,7 +122,224 @@ int main(int argc, char** argv)
      * cf: https://gcc.gnu.org/bugzilla/show_bug.cgi?id=66425
      */
     (void)!RUN_ALL_TESTS();
-    if (wrapping_listener->failed())
+    return wrapping_listener;
+}
+
+/*
+ * Extract (and remove) every --name=VALUE option from the command line
+ *
+ * \param option   The option, including the trailing "="
+ * \return         The VALUE of the last such option, if any
+ */
+auto extract_option(int& argc, char** argv, std::string const& option) -> std::optional<std::string>
+{
+    std::optional<std::string> value;
+    for (auto i = 1; i < argc; )
+    {
+        if (argv[i] && std::string{argv[i]}.starts_with(option))
+        {
+            value = std::string{argv[i]}.substr(option.size());
+
+            for (auto j = i ; j < (argc - 1) ; ++j)
+            {
+                argv[j] = argv[j + 1];
+            }
+            --argc;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return value;
+}
+
+/*
+ * Extract (and remove) a --jobs=N option from the command line
+ *
+ * \return N, 1 if no --jobs option was specified, or 0 if it was invalid
+ */
+auto extract_jobs(int& argc, char** argv) -> int
+{
+    auto const value = extract_option(argc, argv, "--jobs=");
+    if (!value)
+    {
+        return 1;
+    }
+
+    auto jobs = 0;
+    try
+    {
+        jobs = std::stoi(*value);
+    }
+    catch (std::exception const&)
+    {
+    }
+    if (jobs < 1)
+    {
+        std::cerr << "Invalid --jobs=" << *value << ": must be a positive integer" << std::endl;
+        return 0;
+    }
+    return jobs;
+}
+
+/*
+ * Extract (and remove) a --thread-proxy-transport=socket|ring-buffer option
+ * from the command line
+ *
+ * \return false if the option was present but invalid
+ */
+auto extract_thread_proxy_transport(int& argc, char** argv) -> bool
+{
+    auto const value = extract_option(argc, argv, "--thread-proxy-transport=");
+    if (!value)
+    {
+        return true;
+    }
+
+    if (*value == "socket")
+    {
+        wlcs::set_thread_proxy_transport(wlcs::ThreadProxyTransport::socket);
+    }
+    else if (*value == "ring-buffer")
+    {
+        wlcs::set_thread_proxy_transport(wlcs::ThreadProxyTransport::ring_buffer);
+    }
+    else
+    {
+        std::cerr << "Invalid --thread-proxy-transport=" << *value << ": must be one of socket, ring-buffer" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Extract (and remove) a flag from the command line
+ *
+ * \return whether the flag was present
+ */
+auto extract_flag(int& argc, char** argv, std::string const& flag) -> bool
+{
+    auto found = false;
+    for (auto i = 1; i < argc; )
+    {
+        if (argv[i] && flag == argv[i])
+        {
+            found = true;
+            for (auto j = i ; j < (argc - 1) ; ++j)
+            {
+                argv[j] = argv[j + 1];
+            }
+            --argc;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return found;
+}
+
+/*
+ * Exclude the test groups whose names end in Benchmark from the GTest filter
+ *
+ * They measure performance rather than conformance, and take far longer to
+ * run, so only run them when asked to.
+ */
+void exclude_benchmarks()
+{
+    std::string filter = ::testing::GTEST_FLAG(filter);
+    filter += filter.find('-') == std::string::npos ? "-" : ":";
+    filter += "*Benchmark.*";
+    ::testing::GTEST_FLAG(filter) = filter;
+}
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    if (argc < 2 || !argv[1] || std::string{"--help"} == argv[1])
+    {
+        std::cerr
+            << "WayLand Conformance Suite test runner" << std::endl
+            << "Usage: " << argv[0] << " COMPOSITOR_INTEGRATION_MODULE [WLCS OPTIONS]... [GTEST OPTIONS]... [COMPOSITOR_OPTIONS]..." << std::endl
+            << std::endl
+            << "WLCS options:" << std::endl
+            << "  --jobs=N          Run tests in up to N parallel worker processes; cannot be" << std::endl
+            << "                    combined with --gtest_output" << std::endl
+            << "  --benchmarks      Also run the benchmarks (the test groups whose names end in" << std::endl
+            << "                    Benchmark), which are skipped by default" << std::endl
+            << "  --reuse-server    Reset and re-use one server instance across tests, if the" << std::endl
+            << "                    compositor integration supports it" << std::endl
+            << "  --thread-proxy-transport=socket|ring-buffer" << std::endl
+            << "                    How to call into a compositor running on a WLCS-provided" << std::endl
+            << "                    event loop (default: socket)" << std::endl
+            << "  --test-report=FILE" << std::endl
+            << "                    Append the wall time, CPU time, RSS growth and fd usage of" << std::endl
+            << "                    each test to FILE, as one JSON object per line" << std::endl
+            << "  --count-wire-traffic" << std::endl
+            << "                    Relay client connections through a counter of the Wayland" << std::endl
+            << "                    messages, bytes and fds they carry, and add each test's" << std::endl
+            << "                    totals to the --test-report" << std::endl
+            << "  --record-sessions=DIR" << std::endl
+            << "                    Record the protocol session of each client to a file in DIR" << std::endl
+            << "  --replay-sessions=DIR" << std::endl
+            << "                    Replay the sessions recorded in DIR, in the" << std::endl
+            << "                    SessionReplayBenchmark.recorded_sessions test (needs" << std::endl
+            << "                    --benchmarks)" << std::endl;
+        return 1;
+    }
+
+    auto const integration_filename = argv[1];
+
+    // Shuffle the integration module argument out of argv
+    for (auto i = 1 ; i < (argc - 1) ; ++i)
+    {
+        argv[i] = argv[i + 1];
+    }
+    --argc;
+
+    auto const jobs = extract_jobs(argc, argv);
+    if (jobs < 1)
+    {
+        return 1;
+    }
+    if (jobs > 1 && !::testing::GTEST_FLAG(output).empty())
+    {
+        // Each worker would write its own report over the same file
+        std::cerr << "--gtest_output cannot be used with --jobs; use --test-report instead" << std::endl;
+        return 1;
+    }
+    if (!extract_thread_proxy_transport(argc, argv))
+    {
+        return 1;
+    }
+    if (!extract_flag(argc, argv, "--benchmarks"))
+    {
+        exclude_benchmarks();
+    }
+    Options const options{
+        extract_flag(argc, argv, "--reuse-server"),
+        extract_option(argc, argv, "--test-report="),
+        extract_flag(argc, argv, "--count-wire-traffic"),
+        extract_option(argc, argv, "--record-sessions="),
+        extract_option(argc, argv, "--replay-sessions=")};
+
+    wlcs::helpers::set_command_line(argc, const_cast<char const**>(argv));
+
+    if (jobs > 1)
+    {
+        return wlcs::run_tests_in_parallel(
+            jobs,
+            [integration_filename, &options]()
+            {
+                return run_tests(integration_filename, options, false);
+            });
+    }
+
+    auto const listener = run_tests(integration_filename, options, true);
+    if (!listener || listener->failed())
     {
         return EXIT_FAILURE;
     }
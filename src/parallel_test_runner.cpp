@@ -0,0 +1,388 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parallel_test_runner.h"
+#include "xfail_supporting_test_listener.h"
+#include "helpers.h"
+
+#include <gtest/gtest.h>
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+/* Each worker gets 1/(jobs × batches_per_job) of the remaining tests, so batches
+ * start large (to amortise the cost of forking and loading the integration module)
+ * and shrink towards the end of the run (so that the workers finish together).
+ */
+constexpr ptrdiff_t batches_per_job{4};
+
+void write_all(int fd, std::string const& data)
+{
+    size_t written{0};
+    while (written < data.size())
+    {
+        auto const result = write(fd, data.data() + written, data.size() - written);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to write worker data"}));
+        }
+        written += result;
+    }
+}
+
+auto read_all(int fd) -> std::string
+{
+    std::string data;
+    char buffer[4096];
+    off_t offset{0};
+    while (true)
+    {
+        auto const result = pread(fd, buffer, sizeof(buffer), offset);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to read worker data"}));
+        }
+        if (result == 0)
+        {
+            return data;
+        }
+        data.append(buffer, result);
+        offset += result;
+    }
+}
+
+auto wait_for(pid_t pid, int* status) -> pid_t
+{
+    pid_t result;
+    while ((result = waitpid(pid, status, 0)) < 0 && errno == EINTR)
+    {
+    }
+    if (result < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to wait for worker process"}));
+    }
+    return result;
+}
+
+auto describe_exit_status(int status) -> std::string
+{
+    if (WIFSIGNALED(status))
+    {
+        return std::string{"killed by signal "} + std::to_string(WTERMSIG(status)) +
+            " (" + strsignal(WTERMSIG(status)) + ")";
+    }
+    return "exited with status " + std::to_string(WEXITSTATUS(status));
+}
+
+/*
+ * Fork a child process running body(), which returns the child's exit code.
+ *
+ * The child never returns from this function; in particular it does not
+ * run any of the parent's atexit handlers or static destructors.
+ */
+template<typename Body>
+auto fork_child(Body const& body) -> pid_t
+{
+    // Don't duplicate anything buffered in the parent into the child's output
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+
+    auto const pid = fork();
+    if (pid < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to fork worker process"}));
+    }
+    if (pid == 0)
+    {
+        int exit_code{EXIT_FAILURE};
+        try
+        {
+            exit_code = body();
+        }
+        catch (std::exception const& err)
+        {
+            std::cerr << "Worker process failed: " << err.what() << std::endl;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        _exit(exit_code);
+    }
+    return pid;
+}
+
+/*
+ * Resolve the GTest filter (and DISABLED_ handling, etc) into an explicit list of tests.
+ *
+ * This is done by a --gtest_list_tests run in a child process, so that the parent
+ * never calls RUN_ALL_TESTS() itself, and each worker is forked from a pristine
+ * GTest state.
+ */
+auto list_selected_tests() -> std::vector<std::string>
+{
+    auto const results = wlcs::helpers::create_anonymous_file(0);
+
+    auto const pid = fork_child(
+        [results]()
+        {
+            auto const devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+            if (devnull >= 0)
+            {
+                dup2(devnull, STDOUT_FILENO);
+            }
+
+            ::testing::GTEST_FLAG(list_tests) = true;
+            (void)!RUN_ALL_TESTS();
+
+            std::string names;
+            auto const& unit_test = *::testing::UnitTest::GetInstance();
+            for (auto i = 0; i < unit_test.total_test_case_count(); ++i)
+            {
+                auto const test_case = unit_test.GetTestCase(i);
+                for (auto j = 0; j < test_case->total_test_count(); ++j)
+                {
+                    auto const test_info = test_case->GetTestInfo(j);
+                    if (test_info->should_run())
+                    {
+                        names += std::string{test_info->test_case_name()} + "." + test_info->name() + "\n";
+                    }
+                }
+            }
+            write_all(results, names);
+            return EXIT_SUCCESS;
+        });
+
+    int status;
+    wait_for(pid, &status);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        close(results);
+        BOOST_THROW_EXCEPTION((std::runtime_error{"Failed to list tests: " + describe_exit_status(status)}));
+    }
+
+    std::vector<std::string> tests;
+    std::istringstream names{read_all(results)};
+    close(results);
+    for (std::string name; std::getline(names, name);)
+    {
+        tests.push_back(name);
+    }
+    return tests;
+}
+
+struct Worker
+{
+    pid_t pid;
+    std::vector<std::string> tests;
+    int output;     ///< Combined stdout and stderr of the worker
+    int results;    ///< Results, as written by write_results()
+};
+
+/* Worker results are a simple line-based format:
+ *   tests <number of tests run>
+ *   passed <number of tests passed>
+ *   failed <test name>
+ *   skipped <test name>
+ */
+auto format_results(testing::XFailSupportingTestListenerWrapper const& listener) -> std::string
+{
+    auto const& unit_test = *::testing::UnitTest::GetInstance();
+
+    std::string results;
+    results += "tests " + std::to_string(unit_test.test_to_run_count()) + "\n";
+    results += "passed " + std::to_string(unit_test.successful_test_count()) + "\n";
+    for (auto const& name : listener.failed_tests())
+    {
+        results += "failed " + name + "\n";
+    }
+    for (auto const& name : listener.skipped_tests())
+    {
+        results += "skipped " + name + "\n";
+    }
+    return results;
+}
+
+auto spawn_worker(
+    std::vector<std::string> tests,
+    std::function<testing::XFailSupportingTestListenerWrapper const*()> const& run_tests) -> Worker
+{
+    auto const output = wlcs::helpers::create_anonymous_file(0);
+    auto const results = wlcs::helpers::create_anonymous_file(0);
+
+    std::string filter;
+    for (auto const& name : tests)
+    {
+        if (!filter.empty())
+        {
+            filter += ":";
+        }
+        filter += name;
+    }
+
+    auto const pid = fork_child(
+        [&]()
+        {
+            dup2(output, STDOUT_FILENO);
+            dup2(output, STDERR_FILENO);
+
+            ::testing::GTEST_FLAG(filter) = filter;
+            auto const listener = run_tests();
+            if (!listener)
+            {
+                return EXIT_FAILURE;
+            }
+            write_all(results, format_results(*listener));
+            return EXIT_SUCCESS;
+        });
+
+    return Worker{pid, std::move(tests), output, results};
+}
+
+struct MergedResults
+{
+    int test_count{0};
+    int passed_count{0};
+    std::unordered_set<std::string> test_cases;
+    std::unordered_set<std::string> skipped_test_names;
+    std::unordered_set<std::string> failed_test_names;
+};
+
+void merge_worker_results(Worker const& worker, int status, MergedResults& merged)
+{
+    for (auto const& name : worker.tests)
+    {
+        merged.test_cases.insert(name.substr(0, name.find('.')));
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        /* We don't know how far the worker got before it died, so the best we
+         * can do is to blame every test it was given.
+         */
+        auto const reason = describe_exit_status(status);
+        for (auto const& name : worker.tests)
+        {
+            merged.failed_test_names.insert(name + " (worker " + reason + ")");
+        }
+        merged.test_count += worker.tests.size();
+        return;
+    }
+
+    std::istringstream results{read_all(worker.results)};
+    for (std::string key; results >> key;)
+    {
+        results.get();   // Skip the separating space
+        std::string value;
+        std::getline(results, value);
+
+        if (key == "tests")
+        {
+            merged.test_count += std::stoi(value);
+        }
+        else if (key == "passed")
+        {
+            merged.passed_count += std::stoi(value);
+        }
+        else if (key == "failed")
+        {
+            merged.failed_test_names.insert(value);
+        }
+        else if (key == "skipped")
+        {
+            merged.skipped_test_names.insert(value);
+        }
+    }
+}
+}
+
+int wlcs::run_tests_in_parallel(
+    int jobs,
+    std::function<testing::XFailSupportingTestListenerWrapper const*()> const& run_tests)
+{
+    auto const start_time = std::chrono::steady_clock::now();
+
+    auto const tests = list_selected_tests();
+
+    std::cout << "[==========] Running " << tests.size() << " tests in up to " << jobs << " worker processes" << std::endl;
+
+    MergedResults merged;
+    std::unordered_map<pid_t, Worker> running;
+    auto next = tests.begin();
+    while (next != tests.end() || !running.empty())
+    {
+        while (next != tests.end() && running.size() < static_cast<size_t>(jobs))
+        {
+            auto const remaining = std::distance(next, tests.end());
+            auto const batch_size = std::max<ptrdiff_t>(1, remaining / (jobs * batches_per_job));
+
+            auto worker = spawn_worker({next, next + batch_size}, run_tests);
+            next += batch_size;
+            running.emplace(worker.pid, std::move(worker));
+        }
+
+        int status;
+        auto const finished = running.find(wait_for(-1, &status));
+        if (finished == running.end())
+        {
+            continue;
+        }
+
+        auto const& worker = finished->second;
+        std::cout << read_all(worker.output) << std::flush;
+        merge_worker_results(worker, status, merged);
+
+        close(worker.output);
+        close(worker.results);
+        running.erase(finished);
+    }
+
+    auto const elapsed_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time);
+
+    testing::XFailSupportingTestListenerWrapper::print_summary(
+        merged.test_count,
+        merged.test_cases.size(),
+        elapsed_time.count(),
+        merged.passed_count,
+        merged.skipped_test_names,
+        merged.failed_test_names);
+
+    return merged.failed_test_names.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_PARALLEL_TEST_RUNNER_H_
+#define WLCS_PARALLEL_TEST_RUNNER_H_
+
+#include <functional>
+
+namespace testing
+{
+class XFailSupportingTestListenerWrapper;
+}
+
+namespace wlcs
+{
+/**
+ * Run the selected tests across up to \p jobs concurrent worker processes
+ *
+ * The set of tests selected by the GTest command line is split into batches,
+ * which are handed out to forked workers as earlier workers finish. Batches
+ * shrink as the run progresses, so a single slow batch near the end of the
+ * run does not hold up the others.
+ *
+ * The output of each worker is printed as a block once that worker exits,
+ * followed by a single summary merged from every worker. Workers do not
+ * share a --gtest_output report, so it must not be set.
+ *
+ * \param jobs      Maximum number of worker processes to run at once
+ * \param run_tests Called in each worker process, after the GTest filter has
+ *                  been restricted to that worker's batch. It should load the
+ *                  integration module, install an XFailSupportingTestListenerWrapper
+ *                  and RUN_ALL_TESTS(), returning the listener (or nullptr if
+ *                  the tests could not be run).
+ * \return          The process exit code
+ */
+int run_tests_in_parallel(
+    int jobs,
+    std::function<testing::XFailSupportingTestListenerWrapper const*()> const& run_tests);
+}
+
+#endif //WLCS_PARALLEL_TEST_RUNNER_H_
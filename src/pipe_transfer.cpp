@@ -0,0 +1,396 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pipe_transfer.h"
+#include "helpers.h"
+#include "in_process_server.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <random>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+namespace
+{
+size_t const max_block_size = 1 << 20;
+size_t const read_chunk_size = 1 << 20;
+
+[[noreturn]]
+void throw_errno(char const* what)
+{
+    BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), what}));
+}
+
+void set_non_blocking(int fd)
+{
+    auto const flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        throw_errno("Failed to make transfer fd non-blocking");
+    }
+}
+
+/*
+ * Waits for an fd to become readable or writable
+ */
+class Readiness
+{
+public:
+    Readiness(int fd, uint32_t events)
+        : epoll_fd{epoll_create1(EPOLL_CLOEXEC)}
+    {
+        if (epoll_fd < 0)
+        {
+            throw_errno("Failed to create epoll fd");
+        }
+        epoll_event event{};
+        event.events = events;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+        {
+            close(epoll_fd);
+            throw_errno("Failed to watch transfer fd");
+        }
+    }
+
+    ~Readiness()
+    {
+        close(epoll_fd);
+    }
+
+    Readiness(Readiness const&) = delete;
+    auto operator=(Readiness const&) -> Readiness& = delete;
+
+    void wait()
+    {
+        auto const timeout = std::chrono::duration_cast<std::chrono::milliseconds>(wlcs::helpers::a_long_time());
+        epoll_event event;
+        auto const ready = epoll_wait(epoll_fd, &event, 1, timeout.count());
+        if (ready < 0 && errno != EINTR)
+        {
+            throw_errno("Failed to wait for transfer fd");
+        }
+        if (ready == 0)
+        {
+            BOOST_THROW_EXCEPTION((wlcs::Timeout{"Timed out waiting for data transfer"}));
+        }
+    }
+
+private:
+    int const epoll_fd;
+};
+
+/*
+ * Closes an fd, if it has one, when it goes out of scope
+ */
+class OwnedFd
+{
+public:
+    explicit OwnedFd(int fd)
+        : fd{fd}
+    {
+    }
+
+    ~OwnedFd()
+    {
+        reset();
+    }
+
+    OwnedFd(OwnedFd const&) = delete;
+    auto operator=(OwnedFd const&) -> OwnedFd& = delete;
+
+    auto get() const -> int
+    {
+        return fd;
+    }
+
+    void reset()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        fd = -1;
+    }
+
+private:
+    int fd;
+};
+
+/*
+ * Blocks SIGPIPE on this thread, so writing to a pipe with no reader fails
+ * with EPIPE instead of killing us, and discards any SIGPIPE that raised
+ */
+class SigpipeBlocked
+{
+public:
+    SigpipeBlocked()
+    {
+        sigemptyset(&sigpipe);
+        sigaddset(&sigpipe, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &sigpipe, &previous);
+    }
+
+    ~SigpipeBlocked()
+    {
+        timespec const no_wait{0, 0};
+        while (sigtimedwait(&sigpipe, nullptr, &no_wait) > 0)
+        {
+        }
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+
+    SigpipeBlocked(SigpipeBlocked const&) = delete;
+    auto operator=(SigpipeBlocked const&) -> SigpipeBlocked& = delete;
+
+private:
+    sigset_t sigpipe;
+    sigset_t previous;
+};
+
+/*
+ * Fill a block with content derived from seed, returning a memfd holding it
+ */
+auto make_block(size_t size, uint32_t seed) -> int
+{
+    std::vector<uint32_t> content((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    std::minstd_rand generator{seed + 1};
+    std::ranges::generate(content, [&generator]() { return static_cast<uint32_t>(generator()); });
+
+    auto const fd = wlcs::helpers::create_anonymous_file(size);
+    auto const bytes = reinterpret_cast<char const*>(content.data());
+    for (size_t written = 0; written < size; )
+    {
+        auto const result = pwrite(fd, bytes + written, size - written, written);
+        if (result < 0 && errno != EINTR)
+        {
+            close(fd);
+            throw_errno("Failed to write transfer payload");
+        }
+        written += std::max<ssize_t>(result, 0);
+    }
+    return fd;
+}
+
+auto checksum_of(int fd, size_t block_size, size_t total_size) -> uint32_t
+{
+    std::vector<std::byte> block(block_size);
+    if (pread(fd, block.data(), block.size(), 0) != static_cast<ssize_t>(block.size()))
+    {
+        throw_errno("Failed to read back transfer payload");
+    }
+
+    wlcs::StreamChecksum checksum;
+    for (size_t summed = 0; summed < total_size; summed += block_size)
+    {
+        checksum.update(std::span{block}.first(std::min(block_size, total_size - summed)));
+    }
+    return checksum.value();
+}
+}
+
+void wlcs::StreamChecksum::update(std::span<std::byte const> data)
+{
+    uint32_t const modulus = 65521;
+    // The most bytes we can sum before b might overflow, so we only have to
+    // reduce once per run
+    size_t const max_run = 5552;
+
+    while (!data.empty())
+    {
+        auto const run = data.first(std::min(data.size(), max_run));
+        for (auto const byte : run)
+        {
+            a += std::to_integer<uint32_t>(byte);
+            b += a;
+        }
+        a %= modulus;
+        b %= modulus;
+        data = data.subspan(run.size());
+    }
+}
+
+auto wlcs::StreamChecksum::value() const -> uint32_t
+{
+    return (b << 16) | a;
+}
+
+wlcs::TransferPayload::TransferPayload(size_t size, uint32_t seed)
+    : total_size{size},
+      block_size{std::max<size_t>(std::min(size, max_block_size), 1)},
+      block{make_block(block_size, seed)}
+{
+    try
+    {
+        total_checksum = checksum_of(block, block_size, total_size);
+    }
+    catch (...)
+    {
+        close(block);
+        throw;
+    }
+}
+
+wlcs::TransferPayload::~TransferPayload()
+{
+    close(block);
+}
+
+auto wlcs::TransferPayload::size() const -> size_t
+{
+    return total_size;
+}
+
+auto wlcs::TransferPayload::checksum() const -> uint32_t
+{
+    return total_checksum;
+}
+
+void wlcs::TransferPayload::send_to(int fd) const
+{
+    try
+    {
+        set_non_blocking(fd);
+        Readiness writable{fd, EPOLLOUT};
+        SigpipeBlocked const sigpipe_blocked;
+
+        auto use_splice = true;
+        for (size_t sent = 0; sent < total_size; )
+        {
+            auto const position = sent % block_size;
+            auto const length = std::min(total_size - sent, block_size - position);
+
+            ssize_t moved;
+            if (use_splice)
+            {
+                loff_t offset = position;
+                moved = splice(block, &offset, fd, nullptr, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            }
+            else
+            {
+                off_t offset = position;
+                moved = sendfile(fd, block, &offset, length);
+            }
+
+            if (moved < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN)
+                {
+                    writable.wait();
+                    continue;
+                }
+                if (errno == EINVAL && use_splice)
+                {
+                    // Not a pipe
+                    use_splice = false;
+                    continue;
+                }
+                throw_errno("Failed to send transfer payload");
+            }
+            if (moved == 0)
+            {
+                BOOST_THROW_EXCEPTION((std::runtime_error{"Transfer payload is shorter than expected"}));
+            }
+            sent += moved;
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+auto wlcs::receive_transfer(int fd, bool verify) -> ReceivedTransfer
+{
+    ReceivedTransfer result;
+    try
+    {
+        set_non_blocking(fd);
+        Readiness readable{fd, EPOLLIN};
+
+        OwnedFd discard{verify ? -1 : open("/dev/null", O_WRONLY | O_CLOEXEC)};
+        std::vector<std::byte> chunk(verify || discard.get() < 0 ? read_chunk_size : 0);
+        StreamChecksum checksum;
+
+        for (;;)
+        {
+            auto const got = discard.get() >= 0 ?
+                splice(fd, nullptr, discard.get(), nullptr, read_chunk_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK) :
+                read(fd, chunk.data(), chunk.size());
+
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN)
+                {
+                    readable.wait();
+                    continue;
+                }
+                if (errno == EINVAL && discard.get() >= 0)
+                {
+                    // Not a pipe, so we have to read it
+                    discard.reset();
+                    chunk.resize(read_chunk_size);
+                    continue;
+                }
+                throw_errno("Failed to receive transfer");
+            }
+            if (got == 0)
+            {
+                break;
+            }
+
+            if (!result.first_byte)
+            {
+                result.first_byte = std::chrono::steady_clock::now();
+            }
+            result.bytes += got;
+            if (verify)
+            {
+                checksum.update(std::span{chunk}.first(got));
+            }
+        }
+        result.end = std::chrono::steady_clock::now();
+
+        if (verify)
+        {
+            result.checksum = checksum.value();
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    return result;
+}
@@ -0,0 +1,406 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pixel_kernels.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+#include <endian.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WLCS_X86_PIXEL_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace
+{
+using wlcs::ChecksumLanes;
+using wlcs::PixelKernels;
+
+size_t const bytes_per_pixel = 4;
+size_t const checksum_lanes = ChecksumLanes::count;
+
+auto load_pixel(std::byte const* pixel) -> uint32_t
+{
+    uint32_t value;
+    std::memcpy(&value, pixel, sizeof value);
+    return le32toh(value);
+}
+
+auto mask_for(wlcs::PixelFormat format) -> uint32_t
+{
+    return format == wlcs::PixelFormat::xrgb8888 ? 0x00ffffff : 0xffffffff;
+}
+
+namespace scalar
+{
+auto row_is_solid(std::byte const* row, size_t count, uint32_t colour, uint32_t mask) -> bool
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if ((load_pixel(row + i * bytes_per_pixel) & mask) != (colour & mask))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto rows_match(std::byte const* a, std::byte const* b, size_t count, uint32_t mask, uint8_t tolerance) -> bool
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto const pixel_a = load_pixel(a + i * bytes_per_pixel);
+        auto const pixel_b = load_pixel(b + i * bytes_per_pixel);
+        for (auto shift = 0; shift < 32; shift += 8)
+        {
+            if (((mask >> shift) & 0xff) == 0)
+            {
+                continue;
+            }
+            auto const channel_a = static_cast<int>((pixel_a >> shift) & 0xff);
+            auto const channel_b = static_cast<int>((pixel_b >> shift) & 0xff);
+            if (std::abs(channel_a - channel_b) > tolerance)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void row_checksum(std::byte const* row, size_t count, uint32_t mask, ChecksumLanes& lanes)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto const lane = i % checksum_lanes;
+        lanes.a[lane] += load_pixel(row + i * bytes_per_pixel) & mask;
+        lanes.b[lane] += lanes.a[lane];
+    }
+}
+
+PixelKernels const kernels{"scalar", row_is_solid, rows_match, row_checksum};
+}
+
+#ifdef WLCS_X86_PIXEL_KERNELS
+namespace sse2
+{
+__attribute__((target("sse2")))
+auto row_is_solid(std::byte const* row, size_t count, uint32_t colour, uint32_t mask) -> bool
+{
+    auto const expected = _mm_set1_epi32(static_cast<int>(colour & mask));
+    auto const masked = _mm_set1_epi32(static_cast<int>(mask));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        auto const pixels = _mm_and_si128(
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + i * bytes_per_pixel)), masked);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(pixels, expected)) != 0xffff)
+        {
+            return false;
+        }
+    }
+    return scalar::row_is_solid(row + i * bytes_per_pixel, count - i, colour, mask);
+}
+
+__attribute__((target("sse2")))
+auto rows_match(std::byte const* a, std::byte const* b, size_t count, uint32_t mask, uint8_t tolerance) -> bool
+{
+    auto const allowed = _mm_set1_epi8(static_cast<char>(tolerance));
+    auto const masked = _mm_set1_epi32(static_cast<int>(mask));
+    auto const zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        auto const pixels_a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i * bytes_per_pixel));
+        auto const pixels_b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + i * bytes_per_pixel));
+        auto const difference = _mm_or_si128(_mm_subs_epu8(pixels_a, pixels_b), _mm_subs_epu8(pixels_b, pixels_a));
+        auto const excess = _mm_and_si128(_mm_subs_epu8(difference, allowed), masked);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(excess, zero)) != 0xffff)
+        {
+            return false;
+        }
+    }
+    return scalar::rows_match(
+        a + i * bytes_per_pixel, b + i * bytes_per_pixel, count - i, mask, tolerance);
+}
+
+__attribute__((target("sse2")))
+void row_checksum(std::byte const* row, size_t count, uint32_t mask, ChecksumLanes& lanes)
+{
+    auto const masked = _mm_set1_epi32(static_cast<int>(mask));
+    auto a_low = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lanes.a.data()));
+    auto a_high = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lanes.a.data() + 4));
+    auto b_low = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lanes.b.data()));
+    auto b_high = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lanes.b.data() + 4));
+    size_t i = 0;
+    for (; i + checksum_lanes <= count; i += checksum_lanes)
+    {
+        auto const pixels = reinterpret_cast<__m128i const*>(row + i * bytes_per_pixel);
+        a_low = _mm_add_epi32(a_low, _mm_and_si128(_mm_loadu_si128(pixels), masked));
+        a_high = _mm_add_epi32(a_high, _mm_and_si128(_mm_loadu_si128(pixels + 1), masked));
+        b_low = _mm_add_epi32(b_low, a_low);
+        b_high = _mm_add_epi32(b_high, a_high);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes.a.data()), a_low);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes.a.data() + 4), a_high);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes.b.data()), b_low);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes.b.data() + 4), b_high);
+    scalar::row_checksum(row + i * bytes_per_pixel, count - i, mask, lanes);
+}
+
+PixelKernels const kernels{"sse2", row_is_solid, rows_match, row_checksum};
+}
+
+namespace avx2
+{
+__attribute__((target("avx2")))
+auto row_is_solid(std::byte const* row, size_t count, uint32_t colour, uint32_t mask) -> bool
+{
+    auto const expected = _mm256_set1_epi32(static_cast<int>(colour & mask));
+    auto const masked = _mm256_set1_epi32(static_cast<int>(mask));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        auto const pixels = _mm256_and_si256(
+            _mm256_loadu_si256(reinterpret_cast<__m256i const*>(row + i * bytes_per_pixel)), masked);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(pixels, expected)) != -1)
+        {
+            return false;
+        }
+    }
+    return sse2::row_is_solid(row + i * bytes_per_pixel, count - i, colour, mask);
+}
+
+__attribute__((target("avx2")))
+auto rows_match(std::byte const* a, std::byte const* b, size_t count, uint32_t mask, uint8_t tolerance) -> bool
+{
+    auto const allowed = _mm256_set1_epi8(static_cast<char>(tolerance));
+    auto const masked = _mm256_set1_epi32(static_cast<int>(mask));
+    auto const zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        auto const pixels_a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i * bytes_per_pixel));
+        auto const pixels_b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i * bytes_per_pixel));
+        auto const difference = _mm256_or_si256(
+            _mm256_subs_epu8(pixels_a, pixels_b), _mm256_subs_epu8(pixels_b, pixels_a));
+        auto const excess = _mm256_and_si256(_mm256_subs_epu8(difference, allowed), masked);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(excess, zero)) != -1)
+        {
+            return false;
+        }
+    }
+    return sse2::rows_match(
+        a + i * bytes_per_pixel, b + i * bytes_per_pixel, count - i, mask, tolerance);
+}
+
+__attribute__((target("avx2")))
+void row_checksum(std::byte const* row, size_t count, uint32_t mask, ChecksumLanes& lanes)
+{
+    auto const masked = _mm256_set1_epi32(static_cast<int>(mask));
+    auto a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(lanes.a.data()));
+    auto b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(lanes.b.data()));
+    size_t i = 0;
+    for (; i + checksum_lanes <= count; i += checksum_lanes)
+    {
+        auto const pixels = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(row + i * bytes_per_pixel));
+        a = _mm256_add_epi32(a, _mm256_and_si256(pixels, masked));
+        b = _mm256_add_epi32(b, a);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes.a.data()), a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes.b.data()), b);
+    scalar::row_checksum(row + i * bytes_per_pixel, count - i, mask, lanes);
+}
+
+PixelKernels const kernels{"avx2", row_is_solid, rows_match, row_checksum};
+}
+#endif
+
+/*
+ * The fastest kernels this CPU supports
+ */
+auto best_kernels() -> PixelKernels const&
+{
+    static PixelKernels const& best = *wlcs::supported_pixel_kernels().back();
+    return best;
+}
+
+auto row(wlcs::PixelView const& image, int y) -> std::byte const*
+{
+    return image.pixels.data() + static_cast<size_t>(y) * image.stride;
+}
+}
+
+wlcs::PixelView::PixelView(std::span<std::byte const> pixels, Size size, PixelFormat format)
+    : PixelView{pixels, size, size.width.as_int() * static_cast<int>(bytes_per_pixel), format}
+{
+}
+
+wlcs::PixelView::PixelView(std::span<std::byte const> pixels, Size size, int stride, PixelFormat format)
+    : pixels{pixels},
+      size{size},
+      stride{stride},
+      format{format}
+{
+    auto const width = size.width.as_int();
+    auto const height = size.height.as_int();
+    if (width < 0 || height < 0 || stride < width * static_cast<int>(bytes_per_pixel))
+    {
+        BOOST_THROW_EXCEPTION((std::invalid_argument{
+            std::format("Invalid {}x{} image with stride {}", width, height, stride)}));
+    }
+    if (width > 0 && height > 0 &&
+        pixels.size() < static_cast<size_t>(height - 1) * stride + width * bytes_per_pixel)
+    {
+        BOOST_THROW_EXCEPTION((std::invalid_argument{
+            std::format("{} bytes is too small for a {}x{} image with stride {}", pixels.size(), width, height, stride)}));
+    }
+}
+
+auto wlcs::PixelView::sub_view(Rectangle const& region) const -> PixelView
+{
+    if (!Rectangle{{0, 0}, size}.contains(region))
+    {
+        BOOST_THROW_EXCEPTION((std::invalid_argument{"Region is outside the image"}));
+    }
+    auto const offset = static_cast<size_t>(region.top().as_int()) * stride +
+        region.left().as_int() * bytes_per_pixel;
+    return PixelView{pixels.subspan(std::min(offset, pixels.size())), region.size, stride, format};
+}
+
+auto wlcs::supported_pixel_kernels() -> std::vector<PixelKernels const*>
+{
+    std::vector<PixelKernels const*> supported{&scalar::kernels};
+#ifdef WLCS_X86_PIXEL_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        supported.push_back(&sse2::kernels);
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        supported.push_back(&avx2::kernels);
+    }
+#endif
+    return supported;
+}
+
+auto wlcs::is_solid_fill(PixelView const& image, uint32_t colour) -> bool
+{
+    return is_solid_fill(image, colour, best_kernels());
+}
+
+auto wlcs::is_solid_fill(PixelView const& image, uint32_t colour, PixelKernels const& use) -> bool
+{
+    auto const mask = mask_for(image.format);
+    for (auto y = 0; y < image.size.height.as_int(); ++y)
+    {
+        if (!use.row_is_solid(row(image, y), image.size.width.as_int(), colour, mask))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto wlcs::pixels_match(PixelView const& a, PixelView const& b, uint8_t tolerance) -> bool
+{
+    return pixels_match(a, b, tolerance, best_kernels());
+}
+
+auto wlcs::pixels_match(PixelView const& a, PixelView const& b, uint8_t tolerance, PixelKernels const& use) -> bool
+{
+    if (a.size != b.size)
+    {
+        return false;
+    }
+
+    auto const mask = mask_for(a.format) & mask_for(b.format);
+    for (auto y = 0; y < a.size.height.as_int(); ++y)
+    {
+        if (!use.rows_match(row(a, y), row(b, y), a.size.width.as_int(), mask, tolerance))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Counting is a scatter, which SSE2 and AVX2 can't vectorise, so this is the
+ * same everywhere
+ */
+auto wlcs::channel_histograms(PixelView const& image) -> ChannelHistograms
+{
+    ChannelHistograms histograms;
+    auto const has_alpha = image.format == PixelFormat::argb8888;
+    for (auto y = 0; y < image.size.height.as_int(); ++y)
+    {
+        auto const pixels = row(image, y);
+        for (auto x = 0; x < image.size.width.as_int(); ++x)
+        {
+            auto const pixel = load_pixel(pixels + x * bytes_per_pixel);
+            ++histograms.blue[pixel & 0xff];
+            ++histograms.green[(pixel >> 8) & 0xff];
+            ++histograms.red[(pixel >> 16) & 0xff];
+            if (has_alpha)
+            {
+                ++histograms.alpha[pixel >> 24];
+            }
+        }
+    }
+    return histograms;
+}
+
+/*
+ * Each row is summed Fletcher-style in checksum_lanes interleaved lanes,
+ * carried on from row to row, and the lanes hashed together with FNV-1a
+ */
+auto wlcs::pixel_checksum(PixelView const& image) -> uint64_t
+{
+    return pixel_checksum(image, best_kernels());
+}
+
+auto wlcs::pixel_checksum(PixelView const& image, PixelKernels const& use) -> uint64_t
+{
+    auto const mask = mask_for(image.format);
+    ChecksumLanes lanes;
+    for (auto y = 0; y < image.size.height.as_int(); ++y)
+    {
+        use.row_checksum(row(image, y), image.size.width.as_int(), mask, lanes);
+    }
+
+    uint64_t hash{0xcbf29ce484222325};
+    auto const mix = [&hash](uint32_t value)
+        {
+            hash ^= value;
+            hash *= 0x100000001b3;
+        };
+    mix(image.size.width.as_uint32_t());
+    mix(image.size.height.as_uint32_t());
+    for (auto i = 0u; i < checksum_lanes; ++i)
+    {
+        mix(lanes.a[i]);
+        mix(lanes.b[i]);
+    }
+    return hash;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "resource_usage.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace
+{
+auto to_microseconds(timeval const& time) -> std::chrono::microseconds
+{
+    return std::chrono::seconds{time.tv_sec} + std::chrono::microseconds{time.tv_usec};
+}
+
+auto get_rusage(int who) -> rusage
+{
+    rusage usage;
+    if (getrusage(who, &usage) < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to get resource usage"}));
+    }
+    return usage;
+}
+
+/*
+ * The CPU time of a thread of this process
+ *
+ * getrusage(RUSAGE_THREAD) only works for the calling thread, so this reads
+ * utime and stime from /proc, at clock tick resolution. We use it for the
+ * calling thread too, so running and exited threads are measured alike.
+ */
+auto thread_cpu_time(pid_t tid) -> std::optional<wlcs::CpuTime>
+{
+    std::ifstream stat{"/proc/self/task/" + std::to_string(tid) + "/stat"};
+    std::string contents;
+    if (!std::getline(stat, contents))
+    {
+        return {};
+    }
+
+    // The second field is the command name in parentheses, which may contain spaces
+    auto const after_comm = contents.rfind(')');
+    if (after_comm == std::string::npos)
+    {
+        return {};
+    }
+    std::istringstream fields{contents.substr(after_comm + 2)};
+    std::vector<std::string> values;
+    for (std::string value; fields >> value;)
+    {
+        values.push_back(value);
+    }
+
+    // utime and stime are fields 14 and 15; we've skipped the first two
+    if (values.size() < 13)
+    {
+        return {};
+    }
+    auto const ticks_per_second = sysconf(_SC_CLK_TCK);
+    auto const ticks_to_microseconds =
+        [ticks_per_second](std::string const& ticks)
+        {
+            return std::chrono::microseconds{std::stoll(ticks) * 1000000 / ticks_per_second};
+        };
+    return wlcs::CpuTime{ticks_to_microseconds(values[11]), ticks_to_microseconds(values[12])};
+}
+
+auto count_open_fds() -> int
+{
+    std::error_code ignored;
+    int count{0};
+    for (auto it = std::filesystem::directory_iterator{"/proc/self/fd", ignored};
+         it != std::filesystem::directory_iterator{};
+         it.increment(ignored))
+    {
+        ++count;
+    }
+    // Don't count the fd the directory iterator itself has open
+    return count > 0 ? count - 1 : 0;
+}
+
+struct CompositorThreads
+{
+    std::mutex mutex;
+    bool seen{false};
+    std::optional<pid_t> running;
+    /// The CPU time of threads which have exited
+    wlcs::CpuTime exited;
+};
+
+auto compositor_threads() -> CompositorThreads&
+{
+    static CompositorThreads threads;
+    return threads;
+}
+}
+
+auto wlcs::operator-(CpuTime const& lhs, CpuTime const& rhs) -> CpuTime
+{
+    return CpuTime{lhs.user - rhs.user, lhs.system - rhs.system};
+}
+
+auto wlcs::current_resource_usage() -> ResourceUsage
+{
+    auto const self = get_rusage(RUSAGE_SELF);
+
+    ResourceUsage usage{
+        std::chrono::steady_clock::now(),
+        CpuTime{to_microseconds(self.ru_utime), to_microseconds(self.ru_stime)},
+        CpuTime{},
+        false,
+        self.ru_maxrss,
+        count_open_fds()};
+
+    auto& threads = compositor_threads();
+    std::lock_guard lock{threads.mutex};
+    usage.compositor = threads.exited;
+    usage.compositor_thread_seen = threads.seen;
+    if (threads.running)
+    {
+        if (auto const running = thread_cpu_time(*threads.running))
+        {
+            usage.compositor.user += running->user;
+            usage.compositor.system += running->system;
+        }
+    }
+    return usage;
+}
+
+void wlcs::compositor_thread_started()
+{
+    auto& threads = compositor_threads();
+    std::lock_guard lock{threads.mutex};
+    threads.seen = true;
+    threads.running = gettid();
+}
+
+void wlcs::compositor_thread_exiting()
+{
+    auto const self = thread_cpu_time(gettid());
+
+    auto& threads = compositor_threads();
+    std::lock_guard lock{threads.mutex};
+    if (self)
+    {
+        threads.exited.user += self->user;
+        threads.exited.system += self->system;
+    }
+    threads.running.reset();
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_RESOURCE_USAGE_H_
+#define WLCS_RESOURCE_USAGE_H_
+
+#include <chrono>
+
+namespace wlcs
+{
+struct CpuTime
+{
+    std::chrono::microseconds user{0};
+    std::chrono::microseconds system{0};
+};
+
+auto operator-(CpuTime const& lhs, CpuTime const& rhs) -> CpuTime;
+
+/**
+ * A snapshot of the resources used by the wlcs process
+ */
+struct ResourceUsage
+{
+    std::chrono::steady_clock::time_point time;
+    /// CPU time used by the whole process, including any compositor thread
+    CpuTime process;
+    /**
+     * CPU time used by the compositor threads wlcs has run; zero until one has
+     *
+     * This is only available for compositors which run on a WLCS-provided
+     * thread (WlcsDisplayServer::start_on_this_thread); compositors which
+     * start their own threads are indistinguishable from wlcs.
+     */
+    CpuTime compositor;
+    /// Whether wlcs has run any compositor thread yet
+    bool compositor_thread_seen;
+    /// The high-water mark of the process's resident set size, in KiB
+    long peak_rss_kib;
+    int open_fds;
+};
+
+auto current_resource_usage() -> ResourceUsage;
+
+/**
+ * Account CPU time on the calling thread to the compositor
+ *
+ * Call compositor_thread_started() at the start of a compositor thread, and
+ * compositor_thread_exiting() immediately before it exits.
+ */
+void compositor_thread_started();
+void compositor_thread_exiting();
+}
+
+#endif //WLCS_RESOURCE_USAGE_H_
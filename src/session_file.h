@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_SESSION_FILE_H_
+#define WLCS_SESSION_FILE_H_
+
+#include <array>
+#include <cstdint>
+
+/*
+ * The format of a recorded protocol session
+ *
+ * A session file is the magic number followed by a sequence of records, each
+ * a RecordHeader followed by size bytes of payload. Message records hold one
+ * whole Wayland message, in host byte order. fd contents aren't recorded, but
+ * the final record is an fd_sizes record listing, in order, the size of each
+ * fd the client sent, as of the end of the session.
+ */
+namespace wlcs::session_file
+{
+constexpr std::array<char, 8> const magic{'W', 'L', 'C', 'S', 'S', 'E', 'S', '1'};
+
+enum class RecordType : uint8_t
+{
+    request,    ///< A message from the client, sent with fds fds
+    event,      ///< A message from the compositor, sent with fds fds
+    fd_sizes    ///< An array of uint64_t sizes of the client's fds
+};
+
+struct RecordHeader
+{
+    uint64_t time_ns;   ///< Since the start of the session
+    uint32_t size;      ///< Of the payload
+    uint16_t fds;
+    RecordType type;
+    uint8_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 16);
+}
+
+#endif //WLCS_SESSION_FILE_H_
@@ -0,0 +1,442 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "session_replay.h"
+#include "session_file.h"
+#include "helpers.h"
+#include "in_process_server.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sf = wlcs::session_file;
+
+namespace
+{
+std::optional<std::string> recording_directory;
+std::optional<std::string> replay_directory;
+
+/* How long to wait for the compositor to send an event the client saw before
+ * a request, unless the request may depend on it. Events like
+ * wl_buffer.release and wl_callback.done depend on timing, so a replay may
+ * never get as many as the recording did.
+ */
+std::chrono::milliseconds const event_grace_period{20};
+
+/*
+ * Whether a message is wl_display.delete_id, after which the client may
+ * reuse the id
+ */
+auto is_delete_id(std::span<std::byte const> message) -> bool
+{
+    uint32_t header[2];
+    if (message.size() < sizeof header)
+    {
+        return false;
+    }
+    std::memcpy(header, message.data(), sizeof header);
+    return header[0] == 1 && (header[1] & 0xffff) == 1;
+}
+
+struct Record
+{
+    sf::RecordHeader header;
+    std::vector<std::byte> payload;
+};
+
+auto load(std::string const& filename) -> std::vector<Record>
+{
+    std::ifstream file{filename, std::ios::binary};
+    if (!file)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to open " + filename}));
+    }
+
+    std::array<char, sf::magic.size()> magic;
+    if (!file.read(magic.data(), magic.size()) || magic != sf::magic)
+    {
+        BOOST_THROW_EXCEPTION((std::runtime_error{filename + " is not a wlcs session recording"}));
+    }
+
+    std::vector<Record> records;
+    Record record;
+    while (file.read(reinterpret_cast<char*>(&record.header), sizeof record.header))
+    {
+        record.payload.resize(record.header.size);
+        if (!file.read(reinterpret_cast<char*>(record.payload.data()), record.payload.size()))
+        {
+            BOOST_THROW_EXCEPTION((std::runtime_error{filename + " is truncated"}));
+        }
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+/*
+ * One end of a connection to the compositor, sending a recorded session's
+ * requests and discarding the events it gets back
+ */
+class ReplayConnection
+{
+public:
+    ReplayConnection(int fd, std::string const& filename)
+        : fd{fd},
+          filename{filename}
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~ReplayConnection()
+    {
+        close(fd);
+    }
+
+    void send(std::span<std::byte const> message, std::span<int const> fds)
+    {
+        auto fds_sent = fds.empty();
+        while (!message.empty())
+        {
+            iovec iov{const_cast<std::byte*>(message.data()), message.size()};
+            msghdr header{};
+            header.msg_iov = &iov;
+            header.msg_iovlen = 1;
+
+            alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int) * 28)> control;
+            if (!fds_sent)
+            {
+                header.msg_control = control.data();
+                header.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+                auto const cmsg = CMSG_FIRSTHDR(&header);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+                std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+            }
+
+            auto const sent = sendmsg(fd, &header, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                {
+                    wait(POLLOUT);
+                    continue;
+                }
+                disconnected();
+            }
+            fds_sent = true;
+            message = message.subspan(sent);
+        }
+    }
+
+    /**
+     * Discard any events waiting to be read
+     *
+     * \return false if the compositor has closed the connection
+     */
+    auto drain() -> bool
+    {
+        for (;;)
+        {
+            std::array<std::byte, 4096> buffer;
+            alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int) * 28)> control;
+            iovec iov{buffer.data(), buffer.size()};
+            msghdr header{};
+            header.msg_iov = &iov;
+            header.msg_iovlen = 1;
+            header.msg_control = control.data();
+            header.msg_controllen = control.size();
+
+            auto const length = recvmsg(fd, &header, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+            if (length < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return true;
+            }
+            if (length <= 0)
+            {
+                return false;
+            }
+
+            for (auto cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                {
+                    auto const count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    for (auto i = 0u; i < count; ++i)
+                    {
+                        int received;
+                        std::memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof received);
+                        close(received);
+                    }
+                }
+            }
+            event_bytes += length;
+            check_for_errors(std::span{buffer}.first(length));
+        }
+    }
+
+    /**
+     * Wait for \p events on our socket, discarding events from the compositor meanwhile
+     *
+     * \return false if the deadline passed first
+     */
+    auto wait(short events, std::chrono::steady_clock::time_point deadline) -> bool
+    {
+        for (;;)
+        {
+            auto const remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0)
+            {
+                return false;
+            }
+            pollfd waiting{fd, static_cast<short>(events | POLLIN), 0};
+            if (poll(&waiting, 1, remaining.count()) < 0 && errno != EINTR)
+            {
+                BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to wait for compositor"}));
+            }
+            if (waiting.revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                if (!drain() && events != POLLIN)
+                {
+                    disconnected();
+                }
+            }
+            if (waiting.revents & events)
+            {
+                return true;
+            }
+        }
+    }
+
+    void wait(short events)
+    {
+        if (!wait(events, std::chrono::steady_clock::now() + wlcs::helpers::a_long_time()))
+        {
+            BOOST_THROW_EXCEPTION((wlcs::Timeout{"Timed out replaying session"}));
+        }
+    }
+
+    /**
+     * Stop sending, and wait for the compositor to close the connection
+     */
+    void finish()
+    {
+        shutdown(fd, SHUT_WR);
+        auto const deadline = std::chrono::steady_clock::now() + wlcs::helpers::a_long_time();
+        while (drain())
+        {
+            if (!wait(POLLIN, deadline))
+            {
+                BOOST_THROW_EXCEPTION((wlcs::Timeout{"Timed out waiting for compositor to finish replayed session"}));
+            }
+        }
+        if (protocol_error)
+        {
+            disconnected();
+        }
+    }
+
+    /**
+     * Wait until the compositor has caught up to a point in the recording
+     *
+     * We wait as long as it takes for \p delete_id_count wl_display.delete_id
+     * events, but only event_grace_period for the rest of \p count events;
+     * any still missing then are written off, and not waited for again.
+     */
+    void wait_for_events(uint64_t count, uint64_t delete_id_count)
+    {
+        auto const deadline = std::chrono::steady_clock::now() + wlcs::helpers::a_long_time();
+        auto const grace_deadline = std::chrono::steady_clock::now() + event_grace_period;
+        while (delete_ids < delete_id_count || events + written_off < count)
+        {
+            if (!drain())
+            {
+                disconnected();
+            }
+            if (delete_ids < delete_id_count)
+            {
+                if (!wait(POLLIN, deadline))
+                {
+                    BOOST_THROW_EXCEPTION((wlcs::Timeout{std::format(
+                        "Timed out replaying {}: waiting for wl_display.delete_id {}, have {}",
+                        filename, delete_id_count, delete_ids).c_str()}));
+                }
+            }
+            else if (events + written_off < count && !wait(POLLIN, grace_deadline))
+            {
+                written_off = count - events;
+            }
+        }
+    }
+
+    uint64_t event_bytes{0};
+    uint64_t events{0};
+    uint64_t delete_ids{0};
+
+private:
+    /*
+     * Watch for wl_display.error
+     */
+    void check_for_errors(std::span<std::byte const> received)
+    {
+        unparsed.insert(unparsed.end(), received.begin(), received.end());
+        size_t offset{0};
+        while (unparsed.size() - offset >= 2 * sizeof(uint32_t))
+        {
+            uint32_t header[2];
+            std::memcpy(header, unparsed.data() + offset, sizeof header);
+            auto const size = std::max<size_t>(header[1] >> 16, sizeof header);
+            if (unparsed.size() - offset < size)
+            {
+                break;
+            }
+            protocol_error |= header[0] == 1 && (header[1] & 0xffff) == 0;
+            delete_ids += is_delete_id(std::span{unparsed}.subspan(offset, size));
+            ++events;
+            offset += size;
+        }
+        unparsed.erase(unparsed.begin(), unparsed.begin() + offset);
+    }
+
+    [[noreturn]]
+    void disconnected()
+    {
+        BOOST_THROW_EXCEPTION((std::runtime_error{std::format(
+            "Compositor {} replaying {}",
+            protocol_error ? "raised a protocol error" : "disconnected",
+            filename)}));
+    }
+
+    int const fd;
+    std::string const filename;
+    std::vector<std::byte> unparsed;
+    bool protocol_error{false};
+    /// Recorded events we've given up waiting for
+    uint64_t written_off{0};
+};
+}
+
+void wlcs::record_sessions_to(std::optional<std::string> const& directory)
+{
+    recording_directory = directory;
+}
+
+auto wlcs::session_recording_directory() -> std::optional<std::string>
+{
+    return recording_directory;
+}
+
+void wlcs::set_sessions_to_replay(std::optional<std::string> const& directory)
+{
+    replay_directory = directory;
+}
+
+auto wlcs::sessions_to_replay() -> std::optional<std::string>
+{
+    return replay_directory;
+}
+
+auto wlcs::replay_session(Server& server, std::string const& filename, ReplayPacing pacing) -> ReplayResult
+{
+    auto const records = load(filename);
+
+    std::vector<uint64_t> fd_sizes;
+    if (!records.empty() && records.back().header.type == sf::RecordType::fd_sizes)
+    {
+        fd_sizes.resize(records.back().payload.size() / sizeof(uint64_t));
+        std::memcpy(fd_sizes.data(), records.back().payload.data(), fd_sizes.size() * sizeof(uint64_t));
+    }
+    size_t next_fd{0};
+
+    ReplayConnection connection{server.create_client_socket(), filename};
+    ReplayResult result;
+    uint64_t recorded_events{0};
+    uint64_t recorded_delete_ids{0};
+
+    auto const start = std::chrono::steady_clock::now();
+    for (auto const& record : records)
+    {
+        if (record.header.type == sf::RecordType::event)
+        {
+            ++recorded_events;
+            recorded_delete_ids += is_delete_id(record.payload);
+        }
+        if (record.header.type != sf::RecordType::request)
+        {
+            continue;
+        }
+
+        // The client may have been reacting to an event, eg: reusing the id
+        // of an object after wl_display.delete_id, so wait for the compositor
+        // to catch up to where it was when the client sent this request
+        connection.wait_for_events(recorded_events, recorded_delete_ids);
+
+        if (pacing == ReplayPacing::as_recorded)
+        {
+            auto const due = start + std::chrono::nanoseconds{record.header.time_ns};
+            while (std::chrono::steady_clock::now() < due)
+            {
+                connection.wait(0, due);
+            }
+        }
+
+        std::vector<int> fds;
+        for (auto i = 0; i < record.header.fds; ++i)
+        {
+            auto const size = next_fd < fd_sizes.size() ? fd_sizes[next_fd] : 0;
+            ++next_fd;
+            fds.push_back(helpers::create_anonymous_file(size));
+        }
+
+        try
+        {
+            connection.send(record.payload, fds);
+        }
+        catch (...)
+        {
+            std::ranges::for_each(fds, close);
+            throw;
+        }
+        std::ranges::for_each(fds, close);
+
+        ++result.requests;
+        result.request_bytes += record.payload.size();
+    }
+    connection.finish();
+
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    result.event_bytes = connection.event_bytes;
+    return result;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shm_buffer_ring.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+wlcs::ShmBufferRing::ShmBufferRing(Client& client, int width, int height, size_t size)
+    : client{client},
+      slots(size)
+{
+    buffers.reserve(size);
+    for (auto i = 0u; i < size; ++i)
+    {
+        buffers.emplace_back(client, width, height);
+        buffers.back().add_release_listener(
+            [this, i]()
+            {
+                auto& slot = slots[i];
+                slot.busy = false;
+                if (auto const committed = std::exchange(slot.committed_at, std::nullopt))
+                {
+                    slot.latencies->add(std::chrono::steady_clock::now() - *committed);
+                }
+                return true;
+            });
+    }
+}
+
+auto wlcs::ShmBufferRing::has_free_buffer() const -> bool
+{
+    return free_buffer().has_value();
+}
+
+auto wlcs::ShmBufferRing::acquire() -> ShmBuffer&
+{
+    auto const free = free_buffer();
+    if (!free)
+    {
+        BOOST_THROW_EXCEPTION((std::logic_error{"No free buffer to acquire"}));
+    }
+    slots[*free].busy = true;
+    return buffers[*free];
+}
+
+auto wlcs::ShmBufferRing::acquire_when_free() -> ShmBuffer&
+{
+    client.dispatch_until([this]() { return has_free_buffer(); });
+    return acquire();
+}
+
+void wlcs::ShmBufferRing::time_release(ShmBuffer const& buffer, DurationSamples& latencies)
+{
+    for (auto i = 0u; i < buffers.size(); ++i)
+    {
+        if (&buffers[i] == &buffer)
+        {
+            slots[i].committed_at = std::chrono::steady_clock::now();
+            slots[i].latencies = &latencies;
+            return;
+        }
+    }
+    BOOST_THROW_EXCEPTION((std::logic_error{"Buffer is not from this ring"}));
+}
+
+void wlcs::ShmBufferRing::stop_timing_releases()
+{
+    for (auto& slot : slots)
+    {
+        slot.committed_at.reset();
+    }
+}
+
+auto wlcs::ShmBufferRing::free_buffer() const -> std::optional<size_t>
+{
+    for (auto i = 0u; i < slots.size(); ++i)
+    {
+        if (!slots[i].busy)
+        {
+            return i;
+        }
+    }
+    return {};
+}
@@ -20,12 +20,21 @@
 #define WLCS_THREAD_PROXY_H_
 
 #include <wayland-server-core.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <functional>
+#include <memory>
+#include <sys/eventfd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <mutex>
+#include <system_error>
 #include <thread>
 #include <tuple>
+#include <unistd.h>
+#include <utility>
 #include <boost/throw_exception.hpp>
 
 /*
@@ -41,8 +50,9 @@
  * Callable being called on the Wayland event loop.
  *
  * The mechanism used for invoking on the Wayland event loop is a
- * socket: arguments are serialised to the socket, and then deserialised
- * when processed by the event loop.
+ * ThreadProxyChannel: arguments are serialised into a message on the
+ * channel, and then deserialised when processed by the event loop.
+ * There are two channels: a socket, and a lock-free ring buffer.
  *
  * The template metaprogramming is mostly for manipulating parameter
  * packs: serialising them to and from linear buffers (so that they
@@ -118,22 +128,6 @@ std::tuple<Head, Tail...> tuple_from_buffer(char* buffer, std::tuple<Head, Tail.
     return std::tuple_cat(std::make_tuple(aligned_arg), tuple_from_buffer(buffer + sizeof(Head), type_deducer));
 }
 
-std::array<int, 2> setup_socketpair()
-{
-    std::array<int, 2> socket_fds;
-
-    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socket_fds.data()) < 0)
-    {
-        BOOST_THROW_EXCEPTION((
-            std::system_error{
-                errno,
-                std::system_category(),
-                "Failed to create Wayland thread communication socket"}));
-    }
-
-    return socket_fds;
-}
-
 constexpr ssize_t arguments_size()
 {
     return 0;
@@ -185,42 +179,62 @@ constexpr bool all_args_are_trivially_copyable(std::tuple<Args...> const*)
 }
 
 /*
- * ThreadProxy: a mechanism to take a functor from any thread, and turn it into
- * a functor that runs on the Wayland event loop.
- *
- * Theory of operation:
- * The inter-thread channel used is a SOCK_SEQPACKET socket.
- *
- * register_op() takes an (almost) arbitrary Callable, wraps it in a
- * std::function<> that recieves a pointer to a buffer of arguments,
- * unpacks the buffer into a std::tuple, then invokes the original
- * Callable, and adds this function to the handler array.
+ * ThreadProxyChannel: the transport for ThreadProxy messages
  *
- * register_op() then *returns* a function with the same signature that
- * copies the array index of the relevant handler into a falt buffer,
- * marshalls the arguments passed in into the buffer and then pushes that buffer
- * into the socket.
+ * There is only ever one request in flight at a time (ThreadProxy serialises
+ * callers), so a channel needs to carry a request from a client thread to the
+ * Wayland thread, and the reply back again.
+ */
+class ThreadProxyChannel
+{
+public:
+    static constexpr ssize_t max_message_size{1024 + sizeof(uint32_t)};
+
+    virtual ~ThreadProxyChannel() = default;
+
+    /// The fd the Wayland event loop should wait on for requests
+    virtual int wayland_fd() const = 0;
+
+    /// Client side: send a request to the Wayland thread
+    virtual void send_request(char const* message, size_t size) = 0;
+    /// Client side: block until the reply to the last request arrives
+    virtual void receive_reply(void* reply, size_t size) = 0;
+
+    /// Wayland side: call handler(context, message) on each pending request
+    virtual void dispatch_requests(void (*handler)(void*, char*), void* context) = 0;
+    /// Wayland side: reply to the request currently being handled
+    virtual void send_reply(void const* reply, size_t size) = 0;
+};
+
+/*
+ * A SOCK_SEQPACKET socketpair.
  *
- * On the Wayland event loop side, we add a fd event_source to the event_loop
- * which reads from the Wayland end of the socket, extracts the index into the
- * handler array, then calls the handler with the rest of the message buffer.
+ * Each call costs a send() and recv() in each direction.
  */
-class ThreadProxy : public std::enable_shared_from_this<ThreadProxy>
+class SocketChannel : public ThreadProxyChannel
 {
-private:
+public:
+    SocketChannel()
+        : fds{setup_socketpair()}
+    {
+    }
 
-    template<typename... Args>
-    void send_message(uint32_t opcode, Args&& ...args) const
+    ~SocketChannel()
     {
-        char buffer[max_message_size];
-        ssize_t const message_size = sizeof(uint32_t) + arguments_size(args...);
+        close(fds[0]);
+        close(fds[1]);
+    }
 
-        *reinterpret_cast<uint32_t*>(buffer) = opcode;
-        pack_buffer(buffer + sizeof(uint32_t), std::forward<Args>(args)...);
+    int wayland_fd() const override
+    {
+        return fds[Fd::Wayland];
+    }
 
-        auto const written = send(fds[Fd::Client], buffer, message_size, MSG_DONTWAIT);
+    void send_request(char const* message, size_t size) override
+    {
+        auto const written = send(fds[Fd::Client], message, size, MSG_DONTWAIT);
 
-        if (written < message_size)
+        if (written < static_cast<ssize_t>(size))
         {
             if (written < 0)
             {
@@ -236,13 +250,11 @@ private:
         }
     }
 
-    template<typename T>
-    T wait_for_reply() const
+    void receive_reply(void* reply, size_t size) override
     {
-        T buffer;
         // Wait for it to be processed
-        auto const read = recv(fds[Fd::Client], &buffer, sizeof(buffer), 0);
-        if (read < static_cast<ssize_t>(sizeof(buffer)))
+        auto const read = recv(fds[Fd::Client], reply, size, 0);
+        if (read < static_cast<ssize_t>(size))
         {
             if (read < 0)
             {
@@ -256,9 +268,307 @@ private:
                 std::runtime_error{
                     "Received short reply from Wayland thread"}));
         }
+    }
+
+    void dispatch_requests(void (*handler)(void*, char*), void* context) override
+    {
+        char buffer[max_message_size];
+
+        recv(fds[Fd::Wayland], buffer, sizeof(buffer), 0);
+
+        handler(context, buffer);
+    }
+
+    void send_reply(void const* reply, size_t size) override
+    {
+        send(fds[Fd::Wayland], reply, size, 0);
+    }
+
+private:
+    static std::array<int, 2> setup_socketpair()
+    {
+        std::array<int, 2> socket_fds;
+
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socket_fds.data()) < 0)
+        {
+            BOOST_THROW_EXCEPTION((
+                std::system_error{
+                    errno,
+                    std::system_category(),
+                    "Failed to create Wayland thread communication socket"}));
+        }
+
+        return socket_fds;
+    }
+
+    enum Fd
+    {
+        Wayland = 0,
+        Client
+    };
+    std::array<int, 2> const fds;
+};
+
+/*
+ * A single-producer, single-consumer ring buffer of requests, with an eventfd
+ * to wake the Wayland event loop.
+ *
+ * Requests are length-prefixed records in the ring. The eventfd is only
+ * signalled when the Wayland thread may be waiting in its event loop, and
+ * replies are handed back through a single slot, with the client thread
+ * spinning and then futex-waiting (via std::atomic::wait()) on a sequence
+ * number. In the common case a call costs one eventfd write and read, rather
+ * than the four socket syscalls of SocketChannel.
+ *
+ * The producer side is not thread-safe; ThreadProxy serialises callers.
+ */
+class RingBufferChannel : public ThreadProxyChannel
+{
+public:
+    RingBufferChannel()
+        : event_fd{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)}
+    {
+        if (event_fd < 0)
+        {
+            BOOST_THROW_EXCEPTION((
+                std::system_error{
+                    errno,
+                    std::system_category(),
+                    "Failed to create Wayland thread eventfd"}));
+        }
+    }
+
+    ~RingBufferChannel()
+    {
+        close(event_fd);
+    }
+
+    int wayland_fd() const override
+    {
+        return event_fd;
+    }
+
+    void send_request(char const* message, size_t size) override
+    {
+        auto const head = head_.load(std::memory_order_relaxed);
+        auto const record_size = sizeof(uint32_t) + size;
+
+        // Wait for the Wayland thread to make space, if the ring is full
+        for (auto tail = tail_.load(std::memory_order_acquire);
+             capacity - (head - tail) < record_size;
+             tail = tail_.load(std::memory_order_acquire))
+        {
+            tail_.wait(tail, std::memory_order_acquire);
+        }
+
+        uint32_t const length = size;
+        copy_in(head, &length, sizeof(length));
+        copy_in(head + sizeof(length), message, size);
+
+        /* Publish the record, *then* check whether the Wayland thread might be
+         * asleep. dispatch_requests() does the converse (marks itself idle, then
+         * checks for records), so one of us is guaranteed to notice the other.
+         */
+        head_.store(head + record_size, std::memory_order_seq_cst);
+        if (consumer_idle.exchange(false, std::memory_order_seq_cst))
+        {
+            uint64_t const one{1};
+            if (write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            {
+                BOOST_THROW_EXCEPTION((
+                    std::system_error{
+                        errno,
+                        std::system_category(),
+                        "Failed to wake Wayland thread"}));
+            }
+        }
+    }
+
+    void receive_reply(void* reply, size_t size) override
+    {
+        for (auto sequence = reply_sequence.load(std::memory_order_acquire);
+             sequence == replies_received;
+             sequence = reply_sequence.load(std::memory_order_acquire))
+        {
+            reply_sequence.wait(sequence, std::memory_order_acquire);
+        }
+        ++replies_received;
+        memcpy(reply, reply_buffer.data(), size);
+    }
+
+    void dispatch_requests(void (*handler)(void*, char*), void* context) override
+    {
+        uint64_t wakeups;
+        (void)!read(event_fd, &wakeups, sizeof(wakeups));
+
+        char buffer[max_message_size];
+        while (true)
+        {
+            auto tail = tail_.load(std::memory_order_relaxed);
+            while (tail != head_.load(std::memory_order_acquire))
+            {
+                uint32_t length;
+                copy_out(tail, &length, sizeof(length));
+                copy_out(tail + sizeof(length), buffer, length);
+
+                tail += sizeof(length) + length;
+                tail_.store(tail, std::memory_order_release);
+                tail_.notify_one();
+
+                handler(context, buffer);
+            }
+
+            consumer_idle.store(true, std::memory_order_seq_cst);
+            if (head_.load(std::memory_order_seq_cst) == tail)
+            {
+                return;
+            }
+            // A request arrived as we were going idle; keep going.
+            consumer_idle.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void send_reply(void const* reply, size_t size) override
+    {
+        memcpy(reply_buffer.data(), reply, size);
+        reply_sequence.fetch_add(1, std::memory_order_release);
+        reply_sequence.notify_one();
+    }
+
+private:
+    static constexpr size_t capacity{64 * 1024};
+
+    void copy_in(size_t position, void const* data, size_t size)
+    {
+        auto const offset = position % capacity;
+        auto const first = std::min(size, capacity - offset);
+        memcpy(ring.data() + offset, data, first);
+        memcpy(ring.data(), static_cast<char const*>(data) + first, size - first);
+    }
+
+    void copy_out(size_t position, void* data, size_t size) const
+    {
+        auto const offset = position % capacity;
+        auto const first = std::min(size, capacity - offset);
+        memcpy(data, ring.data() + offset, first);
+        memcpy(static_cast<char*>(data) + first, ring.data(), size - first);
+    }
+
+    int const event_fd;
+
+    std::array<char, capacity> ring;
+    // Positions are free-running; only their difference modulo capacity matters
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<bool> consumer_idle{true};
+
+    alignas(64) std::atomic<uint32_t> reply_sequence{0};
+    uint32_t replies_received{0};
+    std::array<char, max_message_size> reply_buffer;
+};
+
+/*
+ * ThreadProxy: a mechanism to take a functor from any thread, and turn it into
+ * a functor that runs on the Wayland event loop.
+ *
+ * Theory of operation:
+ * The inter-thread channel used is a ThreadProxyChannel; either a SOCK_SEQPACKET
+ * socket or a lock-free ring buffer.
+ *
+ * register_op() takes an (almost) arbitrary Callable, wraps it in a
+ * std::function<> that recieves a pointer to a buffer of arguments,
+ * unpacks the buffer into a std::tuple, then invokes the original
+ * Callable, and adds this function to the handler array.
+ *
+ * register_op() then *returns* a function with the same signature that
+ * copies the array index of the relevant handler into a falt buffer,
+ * marshalls the arguments passed in into the buffer and then pushes that buffer
+ * into the channel.
+ *
+ * On the Wayland event loop side, we add a fd event_source to the event_loop
+ * which reads from the Wayland end of the channel, extracts the index into the
+ * handler array, then calls the handler with the rest of the message buffer.
+ *
+ * Batching:
+ * Each call is a full round trip to the Wayland thread. For void Callables
+ * registered with register_async_op() this can be avoided: between begin_batch()
+ * and flush() their calls are appended to a batch buffer instead, and the whole
+ * batch is sent as a single message, which the Wayland thread unpacks and
+ * replies to once. Calls to register_op() functors flush any batched calls
+ * first, so calls are always run in the order they were made.
+ */
+class ThreadProxy : public std::enable_shared_from_this<ThreadProxy>
+{
+private:
+
+    template<typename... Args>
+    void send_message(uint32_t opcode, Args&& ...args) const
+    {
+        char buffer[max_message_size];
+        ssize_t const message_size = sizeof(uint32_t) + arguments_size(args...);
+
+        *reinterpret_cast<uint32_t*>(buffer) = opcode;
+        pack_buffer(buffer + sizeof(uint32_t), std::forward<Args>(args)...);
+
+        channel->send_request(buffer, message_size);
+    }
+
+    template<typename T>
+    T wait_for_reply() const
+    {
+        T buffer;
+        channel->receive_reply(&buffer, sizeof(buffer));
         return buffer;
     }
 
+    /*
+     * Send any batched calls to the Wayland thread, and wait for them to complete
+     *
+     * Must be called with message_serialiser held.
+     */
+    void flush_batch() const
+    {
+        if (batch_count == 0)
+        {
+            return;
+        }
+
+        uint32_t const batch_opcode{Opcode::Batch};
+        memcpy(batch_buffer.data(), &batch_opcode, sizeof(batch_opcode));
+        memcpy(batch_buffer.data() + sizeof(batch_opcode), &batch_count, sizeof(batch_count));
+
+        batch_count = 0;
+        auto const size = std::exchange(batch_size, batch_header_size);
+
+        channel->send_request(batch_buffer.data(), size);
+        wait_for_reply<char>();
+    }
+
+    /*
+     * Append a call to the batch, flushing the batch first if it is full
+     *
+     * Must be called with message_serialiser held.
+     */
+    template<typename... Args>
+    void append_to_batch(uint32_t opcode, Args&& ...args) const
+    {
+        uint32_t const args_size = arguments_size(args...);
+        auto const record_size = 2 * sizeof(uint32_t) + args_size;
+
+        if (batch_size + record_size > batch_buffer.size())
+        {
+            flush_batch();
+        }
+
+        auto const record = batch_buffer.data() + batch_size;
+        memcpy(record, &opcode, sizeof(opcode));
+        memcpy(record + sizeof(opcode), &args_size, sizeof(args_size));
+        pack_buffer(record + 2 * sizeof(uint32_t), std::forward<Args>(args)...);
+
+        batch_size += record_size;
+        ++batch_count;
+    }
+
     template<typename... Args>
     auto make_send_functor(uint32_t opcode, std::tuple<Args...> const*) const
     {
@@ -268,11 +578,28 @@ private:
                 // We technically don't need to serialise the send/receive, but
                 // it's a bit easier if only one request is in flight at once.
                 std::lock_guard<std::mutex> lock{me->message_serialiser};
+                me->flush_batch();
                 me->send_message(opcode, std::forward<Args>(args)...);
                 me->wait_for_reply<char>();
             };
     }
 
+    template<typename... Args>
+    auto make_async_send_functor(uint32_t opcode, std::tuple<Args...> const*) const
+    {
+        return
+            [me = this->shared_from_this(), opcode](Args&& ...args)
+            {
+                std::lock_guard<std::mutex> lock{me->message_serialiser};
+                me->append_to_batch(opcode, std::forward<Args>(args)...);
+                if (!me->batching)
+                {
+                    // Async handlers don't reply, so an unbatched call is a batch of one
+                    me->flush_batch();
+                }
+            };
+    }
+
     template<typename Returns, typename... Args>
     auto make_send_functor(uint32_t opcode, std::tuple<Args...> const*) const
     {
@@ -282,6 +609,7 @@ private:
                 // We technically don't need to serialise the send/receive, but
                 // it's a bit easier if only one request is in flight at once.
                 std::lock_guard<std::mutex> lock{me->message_serialiser};
+                me->flush_batch();
                 me->send_message(opcode, std::forward<Args>(args)...);
                 return me->wait_for_reply<Returns>();
             };
@@ -309,7 +637,7 @@ private:
                 // void functions send a dummy char, to notify the other end that
                 // the call has completed.
                 char const dummy{0};
-                send(fds[Fd::Wayland], &dummy, sizeof(dummy), 0);
+                channel->send_reply(&dummy, sizeof(dummy));
             };
     }
 
@@ -333,7 +661,21 @@ private:
 
                 auto const val = call<typename traits::return_type>(handler, args);
 
-                send(this->fds[Fd::Wayland], &val, sizeof(val), 0);
+                channel->send_reply(&val, sizeof(val));
+            };
+    }
+
+    template<typename Callable, typename... Args>
+    auto make_async_recv_functor(Callable handler, std::tuple<Args...> const*)
+    {
+        return
+            [handler = std::move(handler)](void* data)
+            {
+                std::tuple<Args...> const* type_resolver = nullptr;
+                auto const args = tuple_from_buffer(static_cast<char*>(data), type_resolver);
+
+                // No reply; the Batch handler replies once the whole batch has run
+                call<void>(handler, args);
             };
     }
 public:
@@ -398,14 +740,64 @@ public:
         return make_send_functor<typename traits::return_type>(next_opcode, type_resolver);
     }
 
-    explicit ThreadProxy(struct wl_event_loop* event_loop)
-        : fds{setup_socketpair()},
+    /**
+     * Register a void Callable whose calls may be batched
+     *
+     * Outside of a begin_batch()/flush() pair the returned functor behaves like
+     * one returned from register_op(). Inside a batch, calling it just queues the
+     * call; it will run on the Wayland thread at the next flush(), or before the
+     * next call of a register_op() functor, whichever is first.
+     */
+    template<typename Callable>
+    auto register_async_op(Callable handler)
+    {
+        using traits = callable_traits<typename std::decay<Callable>::type>;
+        static_assert(
+            std::is_same<typename traits::return_type, void>::value,
+            "Only void functions can be called asynchronously");
+        static_assert(
+            sizeof(typename traits::args) < max_arguments_size - batch_header_size - 2 * sizeof(uint32_t),
+            "Attempt to call function with too many arguments; bump max_message_size");
+
+        constexpr typename traits::args const* type_resolver = nullptr;
+        static_assert(
+            all_args_are_trivially_copyable(type_resolver),
+            "All arguments of register_async_op must be TriviallyCopyable as they must support memcpy");
+
+        auto const next_opcode = handlers.size();
+        handlers.emplace_back(make_async_recv_functor(std::move(handler), type_resolver));
+
+        return make_async_send_functor(next_opcode, type_resolver);
+    }
+
+    /**
+     * Start queueing calls to register_async_op() functors rather than waiting for each
+     */
+    void begin_batch()
+    {
+        std::lock_guard<std::mutex> lock{message_serialiser};
+        batching = true;
+    }
+
+    /**
+     * Run all queued calls on the Wayland thread, wait for them to complete, and
+     * end the batch
+     */
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock{message_serialiser};
+        flush_batch();
+        batching = false;
+    }
+
+    ThreadProxy(struct wl_event_loop* event_loop, std::unique_ptr<ThreadProxyChannel> channel)
+        : channel{std::move(channel)},
           source{
               wl_event_loop_add_fd(
                   event_loop,
-                  fds[Fd::Wayland],
+                  this->channel->wayland_fd(),
                   WL_EVENT_READABLE,
-                  &ThreadProxy::socket_readable,
+                  &ThreadProxy::channel_readable,
                   this)},
         // We have to manually implement the destructor() thunk rather than using register_op because
         // the send_functor returned by register_op takes shared reference to this, care of
@@ -414,7 +806,7 @@ public:
           destructor{
               [this]()
               {
-                  send_message(0);
+                  send_message(Opcode::RemoveSource);
               }}
     {
         // We must run wl_event_source_remove() on the Wayland mainloop, too.
@@ -423,39 +815,74 @@ public:
             {
                 wl_event_source_remove(source);
             });
+        handlers.emplace_back(
+            [this](void* data)
+            {
+                auto record = static_cast<char*>(data);
+                uint32_t count;
+                memcpy(&count, record, sizeof(count));
+                record += sizeof(count);
+
+                for (auto i = 0u; i < count; ++i)
+                {
+                    uint32_t opcode, args_size;
+                    memcpy(&opcode, record, sizeof(opcode));
+                    memcpy(&args_size, record + sizeof(opcode), sizeof(args_size));
+                    record += 2 * sizeof(uint32_t);
+
+                    handlers[opcode](record);
+                    record += args_size;
+                }
+
+                char const dummy{0};
+                this->channel->send_reply(&dummy, sizeof(dummy));
+            });
     }
 
+    /*
+     * Any calls still batched are dropped; by the time the last reference
+     * to the ThreadProxy goes away there's no guarantee the Wayland thread
+     * is still running to process them.
+     */
     ~ThreadProxy()
     {
         destructor();
-        close(fds[0]);
-        close(fds[1]);
     }
 
 private:
-    static int socket_readable(int fd, uint32_t /*mask*/, void* data) noexcept
+    static int channel_readable(int /*fd*/, uint32_t /*mask*/, void* data) noexcept
     {
         auto const& me = *static_cast<ThreadProxy*>(data);
-        char buffer[max_message_size];
-
-        recv(fd, buffer, sizeof(buffer), 0);
 
-        auto const opcode = *reinterpret_cast<uint32_t*>(buffer);
-        me.handlers[opcode](buffer + sizeof(uint32_t));
+        me.channel->dispatch_requests(
+            [](void* context, char* message)
+            {
+                auto const& me = *static_cast<ThreadProxy const*>(context);
+                auto const opcode = *reinterpret_cast<uint32_t*>(message);
+                me.handlers[opcode](message + sizeof(uint32_t));
+            },
+            data);
 
         return 0;
     }
 
-    static constexpr ssize_t max_arguments_size{1024};
-    static constexpr ssize_t max_message_size = max_arguments_size + sizeof(uint32_t);
-    enum Fd
+    static constexpr ssize_t max_message_size{ThreadProxyChannel::max_message_size};
+    static constexpr ssize_t max_arguments_size = max_message_size - sizeof(uint32_t);
+    // Batch messages start with the Batch opcode and a count of records
+    static constexpr size_t batch_header_size{2 * sizeof(uint32_t)};
+    enum Opcode : uint32_t
     {
-        Wayland = 0,
-        Client
+        RemoveSource = 0,
+        Batch
     };
-    std::array<int, 2> const fds;
+    std::unique_ptr<ThreadProxyChannel> const channel;
     struct wl_event_source* const source;
     std::mutex mutable message_serialiser;
+    // The batch state is guarded by message_serialiser
+    bool batching{false};
+    std::array<char, max_message_size> mutable batch_buffer;
+    size_t mutable batch_size{batch_header_size};
+    uint32_t mutable batch_count{0};
     std::vector<std::function<void(void*)>> handlers;
     std::function<void()> const destructor;
 };
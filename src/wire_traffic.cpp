@@ -0,0 +1,781 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wire_traffic.h"
+#include "session_file.h"
+#include "generated/wayland-client.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+bool counting_enabled{false};
+
+// libwayland never sends more than this many fds in one sendmsg()
+size_t const max_fds_per_message = 28;
+
+/*
+ * The number of arguments a message signature describes
+ *
+ * Signatures also contain a since-version and '?' nullability markers.
+ */
+auto argument_count(char const* signature) -> size_t
+{
+    return std::count_if(
+        signature,
+        signature + std::strlen(signature),
+        [](char type) { return type != '?' && !(type >= '0' && type <= '9'); });
+}
+
+/*
+ * The interfaces we know of, by name, for resolving wl_registry.bind
+ */
+class Interfaces
+{
+public:
+    void add(wl_interface const* interface)
+    {
+        std::lock_guard lock{mutex};
+        add_locked(interface);
+    }
+
+    auto find(std::string const& name) const -> wl_interface const*
+    {
+        std::lock_guard lock{mutex};
+        auto const found = by_name.find(name);
+        return found != by_name.end() ? found->second : nullptr;
+    }
+
+private:
+    void add_locked(wl_interface const* interface)
+    {
+        if (!interface || !by_name.emplace(interface->name, interface).second)
+        {
+            return;
+        }
+        // Also add every interface its messages can create
+        for (auto const& messages : {
+                std::span{interface->methods, static_cast<size_t>(interface->method_count)},
+                std::span{interface->events, static_cast<size_t>(interface->event_count)}})
+        {
+            for (auto const& message : messages)
+            {
+                for (auto arg = 0u; arg < argument_count(message.signature); ++arg)
+                {
+                    add_locked(message.types[arg]);
+                }
+            }
+        }
+    }
+
+    std::mutex mutable mutex;
+    std::unordered_map<std::string, wl_interface const*> by_name;
+};
+
+auto interfaces() -> Interfaces&
+{
+    static Interfaces interfaces;
+    return interfaces;
+}
+
+/*
+ * Writes a session file; see session_file.h
+ *
+ * The file is written under a temporary name, and only renamed to filename
+ * once it is complete, so readers never see a partial session.
+ */
+class SessionWriter
+{
+public:
+    explicit SessionWriter(std::string const& filename)
+        : filename{filename},
+          partial_filename{filename + ".partial"},
+          file{partial_filename, std::ios::binary | std::ios::trunc},
+          start{std::chrono::steady_clock::now()}
+    {
+        if (!file)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create " + partial_filename}));
+        }
+        file.write(wlcs::session_file::magic.data(), wlcs::session_file::magic.size());
+    }
+
+    ~SessionWriter()
+    {
+        std::vector<uint64_t> sizes;
+        for (auto const fd : client_fds)
+        {
+            struct stat info;
+            sizes.push_back(fstat(fd, &info) == 0 ? info.st_size : 0);
+            close(fd);
+        }
+        write(wlcs::session_file::RecordType::fd_sizes, std::as_bytes(std::span{sizes}), 0);
+        file.close();
+        rename(partial_filename.c_str(), filename.c_str());
+    }
+
+    void request(std::span<std::byte const> message, size_t fds)
+    {
+        write(wlcs::session_file::RecordType::request, message, fds);
+    }
+
+    void event(std::span<std::byte const> message, size_t fds)
+    {
+        write(wlcs::session_file::RecordType::event, message, fds);
+    }
+
+    /**
+     * Take ownership of a copy of an fd the client sent
+     */
+    void keep_client_fd(int fd)
+    {
+        client_fds.push_back(fd);
+    }
+
+private:
+    void write(wlcs::session_file::RecordType type, std::span<std::byte const> payload, size_t fds)
+    {
+        using namespace std::chrono;
+        wlcs::session_file::RecordHeader const header{
+            static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now() - start).count()),
+            static_cast<uint32_t>(payload.size()),
+            static_cast<uint16_t>(fds),
+            type,
+            0};
+        file.write(reinterpret_cast<char const*>(&header), sizeof header);
+        file.write(reinterpret_cast<char const*>(payload.data()), payload.size());
+    }
+
+    std::string const filename;
+    std::string const partial_filename;
+    std::ofstream file;
+    std::chrono::steady_clock::time_point const start;
+    // Kept open so that we can record their final sizes
+    std::vector<int> client_fds;
+};
+
+struct Connection;
+
+/*
+ * One direction of a relayed connection
+ */
+struct Pipe
+{
+    Connection* connection;
+    Pipe* reverse;
+    int from;
+    int to;
+    bool is_requests;
+
+    std::vector<std::byte> unsent;
+    std::deque<int> unsent_fds;     ///< Received fds, owned by us until they are sent
+    std::vector<std::byte> unparsed;
+    std::deque<int> unrecorded_fds;  ///< Copies of received request fds, for a recording to keep
+    size_t unrecorded_fd_count{0};   ///< Received fds not yet attributed to a recorded message
+    bool parse_failed{false};
+    bool waiting_to_send{false};
+};
+
+struct Connection
+{
+    Connection(int client_fd, int server_fd, std::unique_ptr<SessionWriter> recording)
+        : client_fd{client_fd},
+          server_fd{server_fd},
+          recording{std::move(recording)}
+    {
+        requests.reverse = &events;
+        events.reverse = &requests;
+    }
+
+    ~Connection()
+    {
+        for (auto const& pipe : {&requests, &events})
+        {
+            for (auto const fd : pipe->unsent_fds)
+            {
+                close(fd);
+            }
+            for (auto const fd : pipe->unrecorded_fds)
+            {
+                close(fd);
+            }
+        }
+        close(client_fd);
+        close(server_fd);
+    }
+
+    int const client_fd;    ///< Our end of the socket the client talks to
+    int const server_fd;    ///< Our end of the socket the compositor talks to
+    std::unique_ptr<SessionWriter> const recording;
+    Pipe requests{this, nullptr, client_fd, server_fd, true, {}, {}, {}, {}};
+    Pipe events{this, nullptr, server_fd, client_fd, false, {}, {}, {}, {}};
+    std::unordered_map<uint32_t, wl_interface const*> objects{{1, &wl_display_interface}};
+    bool alive{true};
+};
+
+auto padded(uint32_t length) -> size_t
+{
+    return (length + 3) & ~3u;
+}
+
+class Relay
+{
+public:
+    Relay()
+        : epoll_fd{epoll_create1(EPOLL_CLOEXEC)},
+          wake_fd{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)}
+    {
+        if (epoll_fd < 0 || wake_fd < 0)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to set up wire traffic relay"}));
+        }
+        epoll_event wake{EPOLLIN, {.ptr = nullptr}};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake);
+        // The relay thread uses the interface table, so it must outlive us
+        interfaces().add(&wl_display_interface);
+        thread = std::thread{[this]() { run(); }};
+    }
+
+    ~Relay()
+    {
+        uint64_t const stop{1};
+        if (write(wake_fd, &stop, sizeof stop) == sizeof stop)
+        {
+            thread.join();
+        }
+        else
+        {
+            thread.detach();
+        }
+        close(wake_fd);
+        close(epoll_fd);
+    }
+
+    auto add(int server_fd, std::optional<std::string> const& record_to) -> int
+    {
+        std::unique_ptr<SessionWriter> recording;
+        if (record_to)
+        {
+            try
+            {
+                recording = std::make_unique<SessionWriter>(*record_to);
+            }
+            catch (...)
+            {
+                close(server_fd);
+                throw;
+            }
+        }
+
+        int fds[2];
+        if (socketpair(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+        {
+            auto const error = errno;
+            close(server_fd);
+            BOOST_THROW_EXCEPTION((std::system_error{error, std::system_category(), "Failed to create relayed client socket"}));
+        }
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+
+        auto connection = std::make_unique<Connection>(fds[0], server_fd, std::move(recording));
+        epoll_event requests{EPOLLIN, {.ptr = &connection->requests}};
+        epoll_event events{EPOLLIN, {.ptr = &connection->events}};
+        {
+            std::lock_guard lock{connections_mutex};
+            connections.push_back(std::move(connection));
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connections.back()->client_fd, &requests);
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connections.back()->server_fd, &events);
+        }
+        return fds[1];
+    }
+
+    auto traffic() const -> wlcs::WireTraffic
+    {
+        std::lock_guard lock{traffic_mutex};
+        return totals;
+    }
+
+private:
+    void run()
+    {
+        std::array<epoll_event, 64> ready;
+        for (;;)
+        {
+            auto const count = epoll_wait(epoll_fd, ready.data(), ready.size(), -1);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return;
+            }
+
+            auto closed = false;
+            for (auto i = 0; i < count; ++i)
+            {
+                if (!ready[i].data.ptr)
+                {
+                    return;
+                }
+                auto& pipe = *static_cast<Pipe*>(ready[i].data.ptr);
+                auto& connection = *pipe.connection;
+                if (!connection.alive)
+                {
+                    continue;
+                }
+                if (ready[i].events & EPOLLOUT)
+                {
+                    connection.alive = send(*pipe.reverse);
+                }
+                if (connection.alive && (ready[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                {
+                    connection.alive = receive(pipe);
+                }
+                closed |= !connection.alive;
+            }
+
+            if (closed)
+            {
+                std::lock_guard lock{connections_mutex};
+                std::erase_if(connections, [](auto const& connection) { return !connection->alive; });
+            }
+        }
+    }
+
+    /*
+     * Read everything available from pipe.from, and pass it on
+     *
+     * Returns false once either end has gone away
+     */
+    auto receive(Pipe& pipe) -> bool
+    {
+        wlcs::WireTraffic::Direction received;
+        auto open = true;
+        for (;;)
+        {
+            std::array<std::byte, 4096> buffer;
+            alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int) * max_fds_per_message)> control;
+            iovec iov{buffer.data(), buffer.size()};
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control.data();
+            message.msg_controllen = control.size();
+
+            auto const length = recvmsg(pipe.from, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+            if (length < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (length <= 0)
+            {
+                open = length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+                break;
+            }
+
+            for (auto cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                {
+                    auto const fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    for (auto i = 0u; i < fd_count; ++i)
+                    {
+                        int fd;
+                        std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof fd);
+                        pipe.unsent_fds.push_back(fd);
+                        if (pipe.connection->recording && pipe.is_requests)
+                        {
+                            pipe.unrecorded_fds.push_back(fcntl(fd, F_DUPFD_CLOEXEC, 0));
+                        }
+                    }
+                    received.fds += fd_count;
+                    pipe.unrecorded_fd_count += fd_count;
+                }
+            }
+
+            received.bytes += length;
+            pipe.unsent.insert(pipe.unsent.end(), buffer.begin(), buffer.begin() + length);
+            if (!pipe.parse_failed)
+            {
+                pipe.unparsed.insert(pipe.unparsed.end(), buffer.begin(), buffer.begin() + length);
+            }
+        }
+
+        parse(pipe, received);
+        {
+            std::lock_guard lock{traffic_mutex};
+            auto& total = pipe.is_requests ? totals.requests : totals.events;
+            total.messages += received.messages;
+            total.bytes += received.bytes;
+            total.fds += received.fds;
+            for (auto const& [name, count] : received.by_message)
+            {
+                total.by_message[name] += count;
+            }
+        }
+
+        return send(pipe) && open;
+    }
+
+    /*
+     * Send as much of the pipe's backlog as pipe.to will take
+     */
+    auto send(Pipe& pipe) -> bool
+    {
+        while (!pipe.unsent.empty())
+        {
+            iovec iov{pipe.unsent.data(), pipe.unsent.size()};
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+
+            alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int) * max_fds_per_message)> control;
+            auto const fd_count = std::min(pipe.unsent_fds.size(), max_fds_per_message);
+            if (fd_count > 0)
+            {
+                message.msg_control = control.data();
+                message.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+                auto const cmsg = CMSG_FIRSTHDR(&message);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+                for (auto i = 0u; i < fd_count; ++i)
+                {
+                    std::memcpy(CMSG_DATA(cmsg) + i * sizeof(int), &pipe.unsent_fds[i], sizeof(int));
+                }
+            }
+
+            auto const sent = sendmsg(pipe.to, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    wait_to_send(pipe, true);
+                    return true;
+                }
+                return false;
+            }
+
+            pipe.unsent.erase(pipe.unsent.begin(), pipe.unsent.begin() + sent);
+            for (auto i = 0u; i < fd_count; ++i)
+            {
+                close(pipe.unsent_fds.front());
+                pipe.unsent_fds.pop_front();
+            }
+        }
+        wait_to_send(pipe, false);
+        return true;
+    }
+
+    void wait_to_send(Pipe& pipe, bool waiting)
+    {
+        if (pipe.waiting_to_send != waiting)
+        {
+            // pipe.to is registered as the reverse pipe's source
+            epoll_event event{EPOLLIN | (waiting ? EPOLLOUT : 0u), {.ptr = pipe.reverse}};
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, pipe.to, &event);
+            pipe.waiting_to_send = waiting;
+        }
+    }
+
+    /*
+     * Count each complete message in pipe.unparsed, and follow any objects they create
+     */
+    void parse(Pipe& pipe, wlcs::WireTraffic::Direction& counts)
+    {
+        size_t offset{0};
+        while (!pipe.parse_failed && pipe.unparsed.size() - offset >= 2 * sizeof(uint32_t))
+        {
+            uint32_t header[2];
+            std::memcpy(header, pipe.unparsed.data() + offset, sizeof header);
+            auto const size = header[1] >> 16;
+            auto const opcode = header[1] & 0xffff;
+            if (size < sizeof header)
+            {
+                // Not a stream of Wayland messages; stop trying to make sense of it
+                pipe.parse_failed = true;
+                break;
+            }
+            if (pipe.unparsed.size() - offset < size)
+            {
+                break;
+            }
+
+            auto const message = count_message(
+                pipe,
+                header[0],
+                opcode,
+                std::span{pipe.unparsed}.subspan(offset + sizeof header, size - sizeof header),
+                counts);
+            if (pipe.connection->recording)
+            {
+                record(pipe, message, std::span{pipe.unparsed}.subspan(offset, size));
+            }
+            offset += size;
+        }
+        if (pipe.parse_failed)
+        {
+            pipe.unparsed.clear();
+        }
+        else
+        {
+            pipe.unparsed.erase(pipe.unparsed.begin(), pipe.unparsed.begin() + offset);
+        }
+    }
+
+    /*
+     * Add a message to the connection's recording, along with its fds
+     *
+     * libwayland sends fds along with the message which needs them, but we
+     * can only tell which message that is if we know its signature.
+     */
+    void record(Pipe& pipe, wl_message const* message, std::span<std::byte const> bytes)
+    {
+        auto fd_count = message ? static_cast<size_t>(std::ranges::count(std::string_view{message->signature}, 'h')) : 0;
+        fd_count = std::min(fd_count, pipe.unrecorded_fd_count);
+        pipe.unrecorded_fd_count -= fd_count;
+
+        auto& recording = *pipe.connection->recording;
+        if (!pipe.is_requests)
+        {
+            recording.event(bytes, fd_count);
+            return;
+        }
+        recording.request(bytes, fd_count);
+        for (auto i = 0u; i < fd_count && !pipe.unrecorded_fds.empty(); ++i)
+        {
+            recording.keep_client_fd(pipe.unrecorded_fds.front());
+            pipe.unrecorded_fds.pop_front();
+        }
+    }
+
+    /*
+     * Count a message, and note any objects it creates
+     *
+     * Returns the message's description, if we know the interface of its target
+     */
+    auto count_message(
+        Pipe& pipe,
+        uint32_t object,
+        uint32_t opcode,
+        std::span<std::byte const> arguments,
+        wlcs::WireTraffic::Direction& counts) -> wl_message const*
+    {
+        auto& objects = pipe.connection->objects;
+        auto const found = objects.find(object);
+        auto const interface = found != objects.end() ? found->second : nullptr;
+
+        wl_message const* message{nullptr};
+        if (interface)
+        {
+            if (pipe.is_requests && opcode < static_cast<uint32_t>(interface->method_count))
+            {
+                message = &interface->methods[opcode];
+            }
+            else if (!pipe.is_requests && opcode < static_cast<uint32_t>(interface->event_count))
+            {
+                message = &interface->events[opcode];
+            }
+        }
+
+        ++counts.messages;
+        if (!message)
+        {
+            ++counts.by_message[std::format("{}#{}", interface ? interface->name : "unknown", opcode)];
+            return nullptr;
+        }
+        ++counts.by_message[std::format("{}.{}", interface->name, message->name)];
+
+        // Look for new_id arguments, so we know the interfaces of later messages' targets
+        size_t position{0};
+        auto argument{0};
+        std::string last_string;
+        auto const read_uint =
+            [&]() -> std::optional<uint32_t>
+            {
+                if (position + sizeof(uint32_t) > arguments.size())
+                {
+                    return {};
+                }
+                uint32_t value;
+                std::memcpy(&value, arguments.data() + position, sizeof value);
+                position += sizeof value;
+                return value;
+            };
+
+        for (auto type = message->signature; *type; ++type)
+        {
+            switch (*type)
+            {
+            case 'i':
+            case 'u':
+            case 'f':
+            case 'o':
+                if (!read_uint())
+                {
+                    return message;
+                }
+                break;
+            case 's':
+            case 'a':
+            {
+                auto const length = read_uint();
+                if (!length || position + padded(*length) > arguments.size())
+                {
+                    return message;
+                }
+                if (*type == 's' && *length > 0)
+                {
+                    last_string.assign(reinterpret_cast<char const*>(arguments.data() + position), *length - 1);
+                }
+                position += padded(*length);
+                break;
+            }
+            case 'h':
+                break;
+            case 'n':
+            {
+                auto const id = read_uint();
+                if (!id)
+                {
+                    return message;
+                }
+                // wl_registry.bind's new_id is untyped, preceded by the interface name
+                auto created = message->types[argument];
+                if (!created)
+                {
+                    created = interfaces().find(last_string);
+                }
+                if (created)
+                {
+                    interfaces().add(created);
+                    objects[*id] = created;
+                }
+                else
+                {
+                    objects.erase(*id);
+                }
+                break;
+            }
+            default:
+                // Version numbers and nullability markers aren't arguments
+                continue;
+            }
+            ++argument;
+        }
+        return message;
+    }
+
+    int const epoll_fd;
+    int const wake_fd;
+    std::thread thread;
+
+    std::mutex connections_mutex;
+    std::vector<std::unique_ptr<Connection>> connections;
+
+    std::mutex mutable traffic_mutex;
+    wlcs::WireTraffic totals;
+};
+
+auto relay() -> Relay&
+{
+    static Relay relay;
+    return relay;
+}
+
+auto difference(wlcs::WireTraffic::Direction const& lhs, wlcs::WireTraffic::Direction const& rhs)
+    -> wlcs::WireTraffic::Direction
+{
+    wlcs::WireTraffic::Direction difference{
+        lhs.messages - rhs.messages,
+        lhs.bytes - rhs.bytes,
+        lhs.fds - rhs.fds,
+        {}};
+    for (auto const& [name, count] : lhs.by_message)
+    {
+        auto const before = rhs.by_message.find(name);
+        auto const delta = count - (before != rhs.by_message.end() ? before->second : 0);
+        if (delta > 0)
+        {
+            difference.by_message[name] = delta;
+        }
+    }
+    return difference;
+}
+}
+
+auto wlcs::operator-(WireTraffic const& lhs, WireTraffic const& rhs) -> WireTraffic
+{
+    return WireTraffic{difference(lhs.requests, rhs.requests), difference(lhs.events, rhs.events)};
+}
+
+void wlcs::enable_wire_traffic_counting()
+{
+    counting_enabled = true;
+}
+
+auto wlcs::wire_traffic_counting_enabled() -> bool
+{
+    return counting_enabled;
+}
+
+auto wlcs::relay_client_connection(int server_fd, std::optional<std::string> const& record_to) -> int
+{
+    return relay().add(server_fd, record_to);
+}
+
+void wlcs::note_interface(wl_interface const& interface)
+{
+    interfaces().add(&interface);
+}
+
+auto wlcs::current_wire_traffic() -> WireTraffic
+{
+    if (!counting_enabled)
+    {
+        return {};
+    }
+    return relay().traffic();
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WLCS_WIRE_TRAFFIC_H_
+#define WLCS_WIRE_TRAFFIC_H_
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+
+struct wl_interface;
+
+namespace wlcs
+{
+/**
+ * The Wayland protocol traffic between wlcs's clients and the compositor
+ */
+struct WireTraffic
+{
+    struct Direction
+    {
+        uint64_t messages{0};
+        uint64_t bytes{0};
+        uint64_t fds{0};
+        /**
+         * Message counts, keyed by "interface.message"
+         *
+         * Messages to objects of interfaces wlcs doesn't know about are keyed
+         * by interface name (or "unknown") and opcode, as "interface#opcode".
+         */
+        std::map<std::string, uint64_t> by_message;
+    };
+
+    Direction requests;     ///< From clients to the compositor
+    Direction events;       ///< From the compositor to clients
+};
+
+auto operator-(WireTraffic const& lhs, WireTraffic const& rhs) -> WireTraffic;
+
+/**
+ * Count the traffic of every subsequently created client's connection
+ *
+ * This costs a thread hop in each direction per message, so it is off by
+ * default.
+ */
+void enable_wire_traffic_counting();
+auto wire_traffic_counting_enabled() -> bool;
+
+/**
+ * Relay a client connection through the traffic counter, and record it
+ *
+ * \param server_fd The client end of a connection to the compositor; the
+ *                  relay takes ownership of it
+ * \param record_to The file to record the session to, if any
+ * \return          The fd for the client to connect to instead
+ * \throws std::system_error if the relay could not be set up
+ */
+auto relay_client_connection(int server_fd, std::optional<std::string> const& record_to) -> int;
+
+/**
+ * Tell the traffic counter about an interface clients may bind by name
+ *
+ * The counter follows objects created through typed new_id arguments itself,
+ * but wl_registry.bind only names the interface on the wire.
+ */
+void note_interface(wl_interface const& interface);
+
+/**
+ * The traffic counted since counting was enabled
+ */
+auto current_wire_traffic() -> WireTraffic;
+}
+
+#endif //WLCS_WIRE_TRAFFIC_H_
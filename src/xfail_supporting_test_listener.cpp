@@ -18,12 +18,150 @@
 
 #include "xfail_supporting_test_listener.h"
 #include <gtest/gtest.h>
+#include <boost/throw_exception.hpp>
 #include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
 #include "termcolor.hpp"
 
-testing::XFailSupportingTestListenerWrapper::XFailSupportingTestListenerWrapper(std::unique_ptr<testing::TestEventListener>&& wrapped)
-        : delegate{std::move(wrapped)}
+namespace
+{
+auto json_string(std::string const& value) -> std::string
+{
+    std::string quoted{"\""};
+    for (auto const c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            quoted += std::format("\\u{:04x}", static_cast<int>(c));
+        }
+        else
+        {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+auto json_milliseconds(std::chrono::microseconds duration) -> std::string
+{
+    return std::format("{:.3f}", duration.count() / 1000.0);
+}
+
+auto json_cpu_time(wlcs::CpuTime const& time) -> std::string
 {
+    return std::format(
+        "{{\"user_ms\":{},\"system_ms\":{}}}",
+        json_milliseconds(time.user),
+        json_milliseconds(time.system));
+}
+
+auto json_wire_direction(wlcs::WireTraffic::Direction const& direction) -> std::string
+{
+    std::string by_message;
+    for (auto const& [name, count] : direction.by_message)
+    {
+        by_message += std::format("{}{}:{}", by_message.empty() ? "" : ",", json_string(name), count);
+    }
+    return std::format(
+        "{{\"messages\":{},\"bytes\":{},\"fds\":{},\"by_message\":{{{}}}}}",
+        direction.messages,
+        direction.bytes,
+        direction.fds,
+        by_message);
+}
+
+auto json_wire_traffic(wlcs::WireTraffic const& before, wlcs::WireTraffic const& after) -> std::string
+{
+    if (!wlcs::wire_traffic_counting_enabled())
+    {
+        return "null";
+    }
+    auto const traffic = after - before;
+    return std::format(
+        "{{\"requests\":{},\"events\":{}}}",
+        json_wire_direction(traffic.requests),
+        json_wire_direction(traffic.events));
+}
+
+auto format_test_report(
+    std::string const& name,
+    char const* result,
+    wlcs::ResourceUsage const& before,
+    wlcs::ResourceUsage const& after,
+    std::string const& wire_traffic) -> std::string
+{
+    using namespace std::chrono;
+
+    auto const process = after.process - before.process;
+    std::string wlcs_cpu, compositor_cpu{"null"};
+    if (after.compositor_thread_seen)
+    {
+        auto const compositor = after.compositor - before.compositor;
+        wlcs_cpu = json_cpu_time(process - compositor);
+        compositor_cpu = json_cpu_time(compositor);
+    }
+    else
+    {
+        wlcs_cpu = json_cpu_time(process);
+    }
+
+    return std::format(
+        "{{\"test\":{},\"result\":\"{}\",\"wall_ms\":{},"
+        "\"cpu\":{{\"wlcs\":{},\"compositor\":{}}},"
+        "\"peak_rss_delta_kib\":{},\"fds_before\":{},\"fds_after\":{},\"wire\":{}}}\n",
+        json_string(name),
+        result,
+        json_milliseconds(duration_cast<microseconds>(after.time - before.time)),
+        wlcs_cpu,
+        compositor_cpu,
+        after.peak_rss_kib - before.peak_rss_kib,
+        before.open_fds,
+        after.open_fds,
+        wire_traffic);
+}
+}
+
+testing::XFailSupportingTestListenerWrapper::XFailSupportingTestListenerWrapper(
+    std::unique_ptr<testing::TestEventListener>&& wrapped,
+    bool print_summary)
+        : delegate{std::move(wrapped)},
+          print_summary_{print_summary}
+{
+}
+
+testing::XFailSupportingTestListenerWrapper::~XFailSupportingTestListenerWrapper()
+{
+    if (report_fd >= 0)
+    {
+        close(report_fd);
+    }
+}
+
+void testing::XFailSupportingTestListenerWrapper::write_test_report_to(std::string const& filename)
+{
+    auto const fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{
+            errno,
+            std::system_category(),
+            "Failed to open test report " + filename}));
+    }
+    if (report_fd >= 0)
+    {
+        close(report_fd);
+    }
+    report_fd = fd;
 }
 
 void testing::XFailSupportingTestListenerWrapper::OnTestProgramStart(testing::UnitTest const& unit_test)
@@ -57,6 +195,11 @@ void testing::XFailSupportingTestListenerWrapper::OnTestStart(testing::TestInfo
 {
     current_test_info = &test_info;
     current_test_start = std::chrono::steady_clock::now();
+    if (report_fd >= 0)
+    {
+        current_test_usage = wlcs::current_resource_usage();
+        current_test_traffic = wlcs::current_wire_traffic();
+    }
     delegate->OnTestStart(test_info);
 }
 
@@ -112,6 +255,26 @@ void testing::XFailSupportingTestListenerWrapper::OnTestEnd(testing::TestInfo co
     {
         delegate->OnTestEnd(test_info);
     }
+
+    if (current_test_usage)
+    {
+        auto const result =
+            current_skip_reasons || test_info.result()->Skipped() ? "skipped" :
+            test_info.result()->Failed() ? "failed" : "passed";
+
+        auto const report = format_test_report(
+            std::string{test_info.test_case_name()} + "." + test_info.name(),
+            result,
+            *current_test_usage,
+            wlcs::current_resource_usage(),
+            json_wire_traffic(current_test_traffic, wlcs::current_wire_traffic()));
+        // A single write() to an O_APPEND fd, so lines from parallel workers don't interleave
+        if (write(report_fd, report.data(), report.size()) < 0)
+        {
+            std::cerr << "Failed to write test report: " << strerror(errno) << std::endl;
+        }
+        current_test_usage = {};
+    }
     current_skip_reasons = {};
 }
 
@@ -143,23 +306,52 @@ std::string singular_or_plural(char const* base, int count)
 }
 
 void testing::XFailSupportingTestListenerWrapper::OnTestIterationEnd(testing::UnitTest const& unit_test, int /*iteration*/)
+{
+    if (!failed_test_names.empty())
+    {
+        /* Mark the test run as a failure; if multiple iterations are run
+         * only one might fail, making failed_test_names() an unreliable
+         * indicator.
+         */
+        failed_ = true;
+    }
+
+    if (print_summary_)
+    {
+        print_summary(
+            unit_test.test_to_run_count(),
+            unit_test.test_case_to_run_count(),
+            unit_test.elapsed_time(),
+            unit_test.successful_test_count(),
+            skipped_test_names,
+            failed_test_names);
+    }
+}
+
+void testing::XFailSupportingTestListenerWrapper::print_summary(
+    int test_count,
+    int test_case_count,
+    TimeInMillis elapsed_time,
+    int passed_count,
+    std::unordered_set<std::string> const& skipped_test_names,
+    std::unordered_set<std::string> const& failed_test_names)
 {
     std::cout
         << termcolor::green << "[==========] "
         << termcolor::reset
-        << unit_test.test_to_run_count()
+        << test_count
         << " tests from "
-        << unit_test.test_case_to_run_count()
+        << test_case_count
         << " test cases run. ("
-        << unit_test.elapsed_time()
+        << elapsed_time
         << "ms total elapsed)" << std::endl;
 
     std::cout
         << termcolor::green << "[  PASSED  ]"
         << termcolor::reset
         << " "
-        << unit_test.successful_test_count()
-        << singular_or_plural(" test", unit_test.successful_test_count()) << std::endl;
+        << passed_count
+        << singular_or_plural(" test", passed_count) << std::endl;
 
     auto const skipped_tests = skipped_test_names.size();
     if (skipped_tests > 0)
@@ -180,12 +372,6 @@ void testing::XFailSupportingTestListenerWrapper::OnTestIterationEnd(testing::Un
     auto const failed_tests = failed_test_names.size();
     if (failed_tests > 0)
     {
-        /* Mark the test run as a failure; if multiple iterations are run
-         * only one might fail, making failed_test_names() an unreliable
-         * indicator.
-         */
-        failed_ = true;
-
         std::cout
             << termcolor::red << "[  FAILED  ] "
             << termcolor::reset
@@ -210,3 +396,13 @@ bool testing::XFailSupportingTestListenerWrapper::failed() const
 {
     return failed_;
 }
+
+std::unordered_set<std::string> const& testing::XFailSupportingTestListenerWrapper::failed_tests() const
+{
+    return failed_test_names;
+}
+
+std::unordered_set<std::string> const& testing::XFailSupportingTestListenerWrapper::skipped_tests() const
+{
+    return skipped_test_names;
+}
@@ -19,6 +19,9 @@
 #ifndef WLCS_XFAIL_SUPPORTING_TEST_LISTENER_H_
 #define WLCS_XFAIL_SUPPORTING_TEST_LISTENER_H_
 
+#include "resource_usage.h"
+#include "wire_traffic.h"
+
 #include <gtest/gtest.h>
 
 #include <optional>
@@ -32,7 +35,31 @@ namespace testing
 class XFailSupportingTestListenerWrapper : public testing::TestEventListener
 {
 public:
-    explicit XFailSupportingTestListenerWrapper(std::unique_ptr<testing::TestEventListener>&& wrapped);
+    /**
+     * \param wrapped          The listener to forward (non-skipped) events to
+     * \param print_summary    Whether to print the wlcs summary at the end of each
+     *                         iteration. Worker processes of a parallel run leave
+     *                         this to the parent, which prints a merged summary.
+     */
+    explicit XFailSupportingTestListenerWrapper(
+        std::unique_ptr<testing::TestEventListener>&& wrapped,
+        bool print_summary = true);
+    ~XFailSupportingTestListenerWrapper();
+
+    /**
+     * Report the resources used by each test to \p filename
+     *
+     * One JSON object per test is appended to the file, one per line, with
+     * the test's name, result, wall time, user and system CPU time (split into
+     * wlcs and the compositor thread, where there is one), peak RSS growth, and
+     * the number of open fds before and after the test. With wire traffic
+     * counting enabled it also has the Wayland messages, bytes and fds the
+     * test's clients sent and received. Appending means the
+     * worker processes of a parallel run can share one report file.
+     *
+     * \throws std::system_error if the file cannot be opened
+     */
+    void write_test_report_to(std::string const& filename);
 
     void OnTestProgramStart(testing::UnitTest const& unit_test) override;
 
@@ -60,10 +87,33 @@ public:
     void OnTestProgramEnd(testing::UnitTest const& unit_test) override;
 
     bool failed() const;
+
+    /// Fully-qualified names of the tests that failed in the most recent iteration
+    std::unordered_set<std::string> const& failed_tests() const;
+    /// Fully-qualified names of the tests that were skipped in the most recent iteration
+    std::unordered_set<std::string> const& skipped_tests() const;
+
+    /**
+     * Print the wlcs end-of-run summary
+     *
+     * This is used both at the end of each iteration, and by the parallel runner
+     * to print the results merged from each of its worker processes.
+     */
+    static void print_summary(
+        int test_count,
+        int test_case_count,
+        TimeInMillis elapsed_time,
+        int passed_count,
+        std::unordered_set<std::string> const& skipped_test_names,
+        std::unordered_set<std::string> const& failed_test_names);
 private:
     std::unique_ptr<testing::TestEventListener> const delegate;
+    bool const print_summary_;
 
     std::chrono::steady_clock::time_point current_test_start;
+    std::optional<wlcs::ResourceUsage> current_test_usage;
+    wlcs::WireTraffic current_test_traffic;
+    int report_fd{-1};
     ::testing::TestInfo const* current_test_info;
     std::optional<std::vector<std::string>> current_skip_reasons;
 
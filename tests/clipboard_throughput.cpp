@@ -0,0 +1,189 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Clipboard transfer throughput benchmark
+ *
+ * Pastes payloads from 1 KiB to 1 GiB from one client's wl_data_source to
+ * another's wl_data_offer. Each sample runs from the sink sending
+ * wl_data_offer.receive to reading the end of the payload from its pipe;
+ * the compositor's part is forwarding the pipe to the source, so its
+ * overhead shows up in the time to first byte. The source splices its
+ * payload into the pipe and the sink checksums what arrives; the CPU time
+ * the two clients spend on that is reported separately, as the floor that
+ * no compositor can improve on.
+ */
+
+#include "benchmark.h"
+#include "copy_cut_paste.h"
+#include "pipe_transfer.h"
+
+#include <boost/throw_exception.hpp>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <exception>
+#include <format>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace testing;
+using namespace wlcs;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+char const any_mime_type[] = "application/octet-stream";
+
+size_t const max_samples = 20;
+// Enough bytes per payload size for a stable figure, without taking forever
+size_t const bytes_per_size = 256ul << 20;
+
+auto thread_cpu_time() -> std::chrono::nanoseconds
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec};
+}
+
+auto size_name(size_t size) -> std::string
+{
+    if (size >= 1ul << 30)
+    {
+        return std::format("{}GiB", size >> 30);
+    }
+    if (size >= 1ul << 20)
+    {
+        return std::format("{}MiB", size >> 20);
+    }
+    return std::format("{}KiB", size >> 10);
+}
+
+struct ClipboardThroughputBenchmark : StartedInProcessServer
+{
+    CCnPSource source{the_server()};
+    CCnPSink sink{the_server()};
+    Surface const sink_surface{sink.create_surface_with_focus()};
+
+    wl_data_offer* selection{nullptr};
+    std::optional<int> source_fd;
+
+    ClipboardThroughputBenchmark()
+    {
+        EXPECT_CALL(sink.listener, data_offer(_, _)).Times(AnyNumber());
+        EXPECT_CALL(sink.listener, selection(_, _)).WillRepeatedly(SaveArg<1>(&selection));
+        EXPECT_CALL(source.data_source, send(StrEq(any_mime_type), _))
+            .WillRepeatedly([this](auto, int32_t fd) { source_fd = fd; });
+
+        source.offer(any_mime_type);
+        sink.dispatch_until([this]() { return selection != nullptr; });
+    }
+
+    void TearDown() override
+    {
+        source.roundtrip();
+        sink.roundtrip();
+        StartedInProcessServer::TearDown();
+    }
+
+    void measure(size_t size)
+    {
+        auto const samples = std::clamp<size_t>(bytes_per_size / size, 1, max_samples);
+        TransferPayload const payload{size};
+
+        DurationSamples transfer_time, first_byte, copy_cpu;
+        std::chrono::duration<double> total_time{0};
+        for (auto i = 0u; i < samples; ++i)
+        {
+            int pipe_fds[2];
+            if (pipe2(pipe_fds, O_CLOEXEC) < 0)
+            {
+                BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create pipe"}));
+            }
+
+            auto const start = Clock::now();
+            // libwayland has its own copy of the write end once the request is marshalled
+            wl_data_offer_receive(selection, any_mime_type, pipe_fds[1]);
+            close(pipe_fds[1]);
+            source_fd.reset();
+            try
+            {
+                sink.flush();
+                source.dispatch_until([this]() { return source_fd.has_value(); });
+            }
+            catch (...)
+            {
+                close(pipe_fds[0]);
+                throw;
+            }
+
+            std::chrono::nanoseconds write_cpu{0};
+            std::exception_ptr write_error;
+            // If receiving throws, it closes the pipe, so the writer gives up and can be joined
+            std::jthread writer{
+                [fd = *source_fd, &payload, &write_cpu, &write_error]()
+                {
+                    auto const cpu_start = thread_cpu_time();
+                    try
+                    {
+                        payload.send_to(fd);
+                    }
+                    catch (...)
+                    {
+                        write_error = std::current_exception();
+                    }
+                    write_cpu = thread_cpu_time() - cpu_start;
+                }};
+            auto const cpu_start = thread_cpu_time();
+            auto const transfer = receive_transfer(pipe_fds[0]);
+            auto const read_cpu = thread_cpu_time() - cpu_start;
+            writer.join();
+            if (write_error)
+            {
+                std::rethrow_exception(write_error);
+            }
+
+            ASSERT_THAT(transfer.bytes, Eq(size));
+            ASSERT_THAT(transfer.checksum, Optional(payload.checksum()));
+            transfer_time.add(transfer.end - start);
+            total_time += transfer.end - start;
+            first_byte.add(*transfer.first_byte - start);
+            copy_cpu.add(write_cpu + read_cpu);
+        }
+
+        auto const name = "payload_" + size_name(size);
+        report_benchmark(name + ".transfer", transfer_time);
+        report_benchmark(name + ".first_byte", first_byte);
+        report_benchmark(name + ".copy_cpu", copy_cpu);
+        report_benchmark(name + ".throughput", samples * size / total_time.count() / 1e6, "MB_per_second");
+    }
+};
+}
+
+TEST_F(ClipboardThroughputBenchmark, paste_payloads)
+{
+    for (size_t size = 1 << 10; size <= 1ul << 30; size <<= 4)
+    {
+        measure(size);
+    }
+}
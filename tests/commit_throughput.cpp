@@ -0,0 +1,187 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Surface commit throughput benchmark
+ *
+ * Has one client, and then several, attach, damage and commit shm buffers
+ * as fast as the compositor releases them, without waiting for frame
+ * callbacks, at a range of buffer sizes. It reports the rate at which the
+ * compositor accepts commits, and the time from committing each buffer to
+ * the compositor releasing it; together a measure of the compositor's CPU
+ * cost per frame.
+ */
+
+#include "benchmark.h"
+#include "in_process_server.h"
+#include "shm_buffer_ring.h"
+
+#include <gmock/gmock.h>
+
+#include <memory>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+int const warmup_commits = 10;
+int const commits_per_client = 1000;
+int const many_clients = 8;
+
+struct Resolution
+{
+    int width;
+    int height;
+    char const* name;
+};
+
+/*
+ * A client committing a ring of buffers to a single visible surface
+ */
+class Committer
+{
+public:
+    Committer(wlcs::Server& server, Resolution const& resolution, wlcs::DurationSamples& latencies)
+        : client{server},
+          release_latency{latencies},
+          surface{client.create_visible_surface(resolution.width, resolution.height)},
+          resolution{resolution},
+          buffers{client, resolution.width, resolution.height}
+    {
+    }
+
+    Committer(Committer const&) = delete;
+    auto operator=(Committer const&) -> Committer& = delete;
+
+    auto has_free_buffer() const -> bool
+    {
+        return buffers.has_free_buffer();
+    }
+
+    /**
+     * Attach, damage and commit a free buffer
+     *
+     * \pre has_free_buffer()
+     */
+    void commit()
+    {
+        auto& buffer = buffers.acquire();
+        wl_surface_attach(surface, buffer, 0, 0);
+        wl_surface_damage(surface, 0, 0, resolution.width, resolution.height);
+        buffers.time_release(buffer, release_latency);
+        wl_surface_commit(surface);
+        wl_display_flush(client);
+    }
+
+    /// Don't count the releases of buffers already committed
+    void stop_timing_releases()
+    {
+        buffers.stop_timing_releases();
+    }
+
+    wlcs::Client client;
+
+private:
+    wlcs::DurationSamples& release_latency;
+    wlcs::Surface surface;
+    Resolution const resolution;
+    wlcs::ShmBufferRing buffers;
+};
+
+struct CommitThroughputBenchmark : wlcs::StartedInProcessServer, WithParamInterface<Resolution>
+{
+    /*
+     * Commit commits_per_client buffers from each of client_count clients, round robin,
+     * and report the results
+     */
+    void run(int client_count)
+    {
+        std::vector<std::unique_ptr<Committer>> committers;
+        wlcs::Dispatcher dispatcher;
+        for (auto i = 0; i < client_count; ++i)
+        {
+            committers.push_back(std::make_unique<Committer>(the_server(), GetParam(), release_latency));
+            dispatcher.add(committers.back()->client);
+        }
+
+        commit_round_robin(committers, dispatcher, warmup_commits);
+        dispatcher.roundtrip();
+
+        for (auto const& committer : committers)
+        {
+            committer->stop_timing_releases();
+        }
+        release_latency = {};
+
+        auto const start = Clock::now();
+        commit_round_robin(committers, dispatcher, commits_per_client);
+        // The compositor has accepted a commit once it has processed it
+        dispatcher.roundtrip();
+        auto const elapsed = std::chrono::duration<double>{Clock::now() - start}.count();
+
+        wlcs::report_benchmark("commit_rate", client_count * commits_per_client / elapsed, "per_second");
+        wlcs::report_benchmark("release_latency", release_latency);
+    }
+
+    void commit_round_robin(
+        std::vector<std::unique_ptr<Committer>> const& committers,
+        wlcs::Dispatcher& dispatcher,
+        int commits)
+    {
+        for (auto i = 0; i < commits; ++i)
+        {
+            for (auto const& committer : committers)
+            {
+                if (!committer->has_free_buffer())
+                {
+                    // Some compositors only release a buffer once a newer one is on screen
+                    committer->client.advance_frame_clock();
+                    dispatcher.dispatch_until([&committer]() { return committer->has_free_buffer(); });
+                }
+                committer->commit();
+            }
+        }
+    }
+
+    // Shared by every Committer
+    wlcs::DurationSamples release_latency;
+};
+}
+
+TEST_P(CommitThroughputBenchmark, one_client)
+{
+    run(1);
+}
+
+TEST_P(CommitThroughputBenchmark, many_clients)
+{
+    run(many_clients);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    ,
+    CommitThroughputBenchmark,
+    Values(
+        Resolution{64, 64, "64x64"},
+        Resolution{512, 512, "512x512"},
+        Resolution{1920, 1080, "1920x1080"}),
+    [](testing::TestParamInfo<Resolution> const& info) -> std::string
+    {
+        return info.param.name;
+    });
@@ -271,6 +271,15 @@ TEST_F(ExtForeignToplevelListTest, detects_multiple_toplevels_from_multiple_clie
     ASSERT_THAT(list.toplevels().size(), Eq(2u));
 }
 
+TEST_F(ExtForeignToplevelListTest, detects_many_toplevels_from_same_client)
+{
+    auto const surfaces{client.create_visible_surfaces(20, w, h)};
+
+    ForeignToplevelList list{client};
+    client.roundtrip();
+    ASSERT_THAT(list.toplevels().size(), Eq(20u));
+}
+
 TEST_F(ExtForeignToplevelListTest, handle_gets_title)
 {
     std::string const title = "Test Title @!\\-";
@@ -14,9 +14,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "benchmark.h"
 #include "geometry/rectangle.h"
 #include "geometry/size.h"
 #include "in_process_server.h"
+#include "pixel_checks.h"
 #include "version_specifier.h"
 #include "wl_interface_descriptor.h"
 #include "expect_protocol_error.h"
@@ -26,6 +28,13 @@
 #include <boost/throw_exception.hpp>
 #include <gmock/gmock.h>
 
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
 using namespace testing;
 
 namespace wlcs {
@@ -387,7 +396,7 @@ TEST_F(ExtImageCopyCaptureTest, capture_succeeds)
     // zeroed out initial state. As the format includes an alpha
     // channel and we expect the output to be opaque, this should be
     // true.
-    EXPECT_THAT(data, Contains(Ne(std::byte{0})));
+    EXPECT_THAT(wlcs::is_solid_fill(wlcs::PixelView{data, buffer_size}, 0), IsFalse());
 
     // First frame should damage the entire buffer
     EXPECT_THAT(frame.damage(), ElementsAre(wlcs::Rectangle{{0, 0}, buffer_size}));
@@ -542,7 +551,11 @@ TEST_F(ExtImageCopyCaptureTest, cursor_session_captures_pointer_image)
         ext_image_copy_capture_frame_v1_capture(frame);
         client.dispatch_until([&frame]() { return frame.is_ready() || frame.failure_reason() != std::nullopt; });
         ASSERT_THAT(frame.is_ready(), IsTrue());
-        EXPECT_THAT(capture_buffer.data(), ElementsAreArray(cursor_buffer1.data()));
+        EXPECT_THAT(
+            wlcs::pixels_match(
+                wlcs::PixelView{capture_buffer.data(), wlcs::Size{32, 32}},
+                wlcs::PixelView{cursor_buffer1.data(), wlcs::Size{32, 32}}),
+            IsTrue());
         EXPECT_THAT(cursor_session.hotspot(), Eq(wlcs::Point{16, 16}));
     }
 
@@ -561,7 +574,387 @@ TEST_F(ExtImageCopyCaptureTest, cursor_session_captures_pointer_image)
         ext_image_copy_capture_frame_v1_capture(frame);
         client.dispatch_until([&frame]() { return frame.is_ready() || frame.failure_reason() != std::nullopt; });
         ASSERT_THAT(frame.is_ready(), IsTrue());
-        EXPECT_THAT(capture_buffer.data(), ElementsAreArray(cursor_buffer2.data()));
+        EXPECT_THAT(
+            wlcs::pixels_match(
+                wlcs::PixelView{capture_buffer.data(), wlcs::Size{32, 32}},
+                wlcs::PixelView{cursor_buffer2.data(), wlcs::Size{32, 32}}),
+            IsTrue());
+    }
+}
+
+/*
+ * Captures an output continuously while a second client animates a surface
+ * on it, the way a screen recorder would: one frame in flight at a time,
+ * captured into a ring of buffers that are allocated once and reused.
+ */
+class ExtImageCopyCaptureBenchmark
+    : public ExtImageCopyCaptureTest
+{
+public:
+    static int const animated_x = 100, animated_y = 100;
+
+    /**
+     * Start a capture session on the first output, and allocate the ring
+     *
+     * \return false if the compositor doesn't support ARGB8888 captures
+     */
+    auto start_session(size_t ring_size) -> bool
+    {
+        source_manager.emplace(client.bind_if_supported<ext_output_image_capture_source_manager_v1>(wlcs::AnyVersion));
+        capture_manager.emplace(client.bind_if_supported<ext_image_copy_capture_manager_v1>(wlcs::AnyVersion));
+        output.emplace(client.output_state(0));
+        source.emplace(wlcs::wrap_wl_object(
+            ext_output_image_capture_source_manager_v1_create_source(*source_manager, output->output)));
+        session.emplace(ext_image_copy_capture_manager_v1_create_session(*capture_manager, *source, 0));
+        client.roundtrip();
+
+        if (session->is_dirty() || !session->buffer_size())
+        {
+            return false;
+        }
+        buffer_size = session->buffer_size().value();
+        auto const formats = session->shm_formats();
+        if (std::ranges::find(formats, WL_SHM_FORMAT_ARGB8888) == formats.end())
+        {
+            return false;
+        }
+
+        ring.reserve(ring_size);
+        for (auto i = 0u; i < ring_size; ++i)
+        {
+            ring.emplace_back(client, buffer_size.width.as_int(), buffer_size.height.as_int());
+        }
+        return true;
+    }
+
+    /**
+     * Where \p rect, relative to the animated surface, is in the capture
+     */
+    auto in_capture(wlcs::Rectangle const& rect) const -> wlcs::Rectangle
+    {
+        auto const [output_x, output_y] = output->geometry_position.value_or(std::pair{0, 0});
+        auto const scale = output->scale.value_or(1);
+        return intersection_of(
+            wlcs::Rectangle{
+                {(animated_x + rect.left().as_int() - output_x) * scale,
+                 (animated_y + rect.top().as_int() - output_y) * scale},
+                {rect.size.width.as_int() * scale, rect.size.height.as_int() * scale}},
+            wlcs::Rectangle{{0, 0}, buffer_size});
+    }
+
+    /**
+     * Start capturing into the next buffer of the ring
+     *
+     * We don't keep track of what each buffer has missed since it was last
+     * captured into, so have the compositor fill in all of it.
+     */
+    void capture()
+    {
+        // Replacing the frame destroys the previous one, so we only ever have one
+        frame.emplace(ext_image_copy_capture_session_v1_create_frame(*session));
+        ext_image_copy_capture_frame_v1_attach_buffer(*frame, ring[captured++ % ring.size()]);
+        ext_image_copy_capture_frame_v1_damage_buffer(
+            *frame, 0, 0, buffer_size.width.as_int(), buffer_size.height.as_int());
+        ext_image_copy_capture_frame_v1_capture(*frame);
+        wl_display_flush(client);
+    }
+
+    void wait_for_capture()
+    {
+        client.dispatch_until([this]() { return frame->is_ready() || frame->failure_reason() != std::nullopt; });
+        if (!frame->is_ready())
+        {
+            BOOST_THROW_EXCEPTION((std::runtime_error{
+                std::format("Capture failed, reason {}", *frame->failure_reason())}));
+        }
+    }
+
+    /// The buffer the latest frame was captured into
+    auto latest_capture() const -> wlcs::ShmBuffer const&
+    {
+        return ring[(captured - 1) % ring.size()];
+    }
+
+    /// The buffer the frame before that was captured into
+    auto previous_capture() const -> wlcs::ShmBuffer const&
+    {
+        return ring[(captured - 2) % ring.size()];
+    }
+
+    wlcs::Client animator{the_server()};
+
+    std::optional<wlcs::WlHandle<ext_output_image_capture_source_manager_v1>> source_manager;
+    std::optional<wlcs::WlHandle<ext_image_copy_capture_manager_v1>> capture_manager;
+    std::optional<wlcs::OutputState> output;
+    std::optional<wlcs::WlHandle<ext_image_capture_source_v1>> source;
+    std::optional<ImageCopyCaptureSession> session;
+    wlcs::Size buffer_size;
+    std::vector<wlcs::ShmBuffer> ring;
+    std::optional<ImageCopyCaptureFrame> frame;
+    size_t captured{0};
+};
+
+auto area_of(wlcs::Rectangle const& rect) -> long
+{
+    return long{rect.size.width.as_int()} * rect.size.height.as_int();
+}
+
+TEST_F(ExtImageCopyCaptureBenchmark, sustained_capture_of_animated_surface)
+{
+    int const warmup_frames = 5;
+    int const frames = 200;
+    int const animated_size = 64;
+
+    wlcs::Surface animated{animator.create_visible_surface(animated_size, animated_size)};
+    the_server().move_surface_to(animated, animated_x, animated_y);
+
+    ASSERT_THAT(start_session(3), IsTrue());
+
+    // Where each frame of the animation should be damaged
+    auto const changed = in_capture({{0, 0}, {animated_size, animated_size}});
+    ASSERT_THAT(area_of(changed), Gt(0)) << "Animated surface is not on the captured output";
+
+    auto const animate = [&]()
+        {
+            animated.attach_buffer(animated_size, animated_size);
+            wl_surface_damage(animated, 0, 0, animated_size, animated_size);
+            wl_surface_commit(animated);
+            animator.advance_frame_clock();
+        };
+
+    // The first frame is all damage; get that, and the compositor's caches, out of the way
+    for (auto i = 0; i < warmup_frames; ++i)
+    {
+        capture();
+        animate();
+        wait_for_capture();
+    }
+
+    wlcs::DurationSamples damage_to_ready;
+    int minimal_frames{0};
+    int incomplete_frames{0};
+    double reported_area{0};
+
+    auto const start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < frames; ++i)
+    {
+        capture();
+        auto const damaged = std::chrono::steady_clock::now();
+        animate();
+        wait_for_capture();
+        damage_to_ready.add(std::chrono::steady_clock::now() - damaged);
+
+        long area{0}, changed_area{0};
+        for (auto const& rect : frame->damage())
+        {
+            area += area_of(rect);
+            changed_area += area_of(intersection_of(rect, changed));
+        }
+        reported_area += area;
+        if (changed_area < area_of(changed))
+        {
+            ++incomplete_frames;
+        }
+        else if (area == area_of(changed))
+        {
+            ++minimal_frames;
+        }
+    }
+    auto const elapsed = std::chrono::duration<double>{std::chrono::steady_clock::now() - start}.count();
+
+    wlcs::report_benchmark("captures", frames / elapsed, "per_second");
+    wlcs::report_benchmark("damage_to_ready", damage_to_ready);
+    wlcs::report_benchmark("damage.minimal_frames", 100.0 * minimal_frames / frames, "percent");
+    wlcs::report_benchmark("damage.reported_area", reported_area / frames / area_of(changed), "times_minimal");
+
+    // Reporting too much damage costs the recorder; reporting too little is a bug
+    EXPECT_THAT(incomplete_frames, Eq(0)) << "Frames whose damage missed part of the animated surface";
+}
+
+/*
+ * What actually changed between two captures, and how much of it the
+ * compositor's damage missed
+ */
+struct CaptureDiff
+{
+    wlcs::Rectangle bounds;     ///< Of every changed pixel; empty if nothing changed
+    long changed_pixels{0};
+    long undamaged_pixels{0};   ///< Changed, but outside every damage rectangle
+};
+
+/*
+ * Compare two captures of the same size
+ *
+ * Most rows of a small update are untouched, so each row is first checked
+ * whole with the vectorised wlcs::pixels_match(); only the rows that differ
+ * are scanned a pixel at a time.
+ */
+auto diff_captures(
+    wlcs::PixelView const& before,
+    wlcs::PixelView const& after,
+    std::vector<wlcs::Rectangle> const& damage) -> CaptureDiff
+{
+    auto const width = before.size.width.as_int();
+    auto const height = before.size.height.as_int();
+
+    CaptureDiff diff;
+    int left{width}, right{0}, top{height}, bottom{0};
+    for (auto y = 0; y < height; ++y)
+    {
+        wlcs::Rectangle const row{{0, y}, {width, 1}};
+        if (wlcs::pixels_match(before.sub_view(row), after.sub_view(row)))
+        {
+            continue;
+        }
+
+        for (auto x = 0; x < width; ++x)
+        {
+            wlcs::Rectangle const pixel{{x, y}, {1, 1}};
+            if (wlcs::pixels_match(before.sub_view(pixel), after.sub_view(pixel)))
+            {
+                continue;
+            }
+
+            ++diff.changed_pixels;
+            left = std::min(left, x);
+            right = std::max(right, x + 1);
+            top = std::min(top, y);
+            bottom = std::max(bottom, y + 1);
+            if (std::ranges::none_of(damage, [p = wlcs::Point{x, y}](auto const& rect) { return rect.contains(p); }))
+            {
+                ++diff.undamaged_pixels;
+            }
+        }
+    }
+
+    if (diff.changed_pixels > 0)
+    {
+        diff.bounds = wlcs::Rectangle{{left, top}, {right - left, bottom - top}};
+    }
+    return diff;
+}
+
+/*
+ * A set of small areas of a surface for the client to redraw, and damage
+ * with wl_surface.damage_buffer
+ */
+struct SmallUpdate
+{
+    char const* name;
+    std::vector<wlcs::Rectangle> rects;
+};
+
+/*
+ * Makes small, controlled updates to a surface and works out, by diffing
+ * successive captures, what really changed on the output. Each kind of
+ * update is then scored by how much more than that the compositor reported
+ * as damaged; over-reported damage is encoded for nothing by a screencast.
+ */
+TEST_F(ExtImageCopyCaptureBenchmark, damage_accuracy_of_small_updates)
+{
+    int const frames_per_update = 20;
+    int const animated_size = 256;
+
+    wlcs::Surface animated{animator.create_visible_surface(animated_size, animated_size)};
+    the_server().move_surface_to(animated, animated_x, animated_y);
+    if (wl_proxy_get_version(reinterpret_cast<wl_proxy*>(static_cast<wl_surface*>(animated))) <
+        WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION)
+    {
+        ::testing::Test::RecordProperty("wlcs-skip-test", "wl_surface.damage_buffer not supported");
+        FAIL() << "wl_surface.damage_buffer not supported";
+    }
+
+    ASSERT_THAT(start_session(2), IsTrue());
+
+    std::vector<SmallUpdate> const updates{
+        {"pixel", {{{128, 128}, {1, 1}}}},
+        {"tile", {{{64, 64}, {16, 16}}}},
+        {"row", {{{0, 100}, {animated_size, 1}}}},
+        {"column", {{{100, 0}, {1, animated_size}}}},
+        {"opposite_corners", {{{0, 0}, {8, 8}}, {{animated_size - 8, animated_size - 8}, {8, 8}}}},
+    };
+
+    // What the client has drawn, to redraw in full into each new buffer
+    std::vector<uint32_t> content(animated_size * animated_size, 0xff000000);
+    uint32_t colour{0xff000000};
+    auto const redraw = [&](std::vector<wlcs::Rectangle> const& rects)
+        {
+            // Opaque, and different from anything drawn before
+            colour = 0xff000000 | ((colour + 0x00123457) & 0x00ffffff);
+            for (auto const& rect : rects)
+            {
+                for (auto y = rect.top().as_int(); y < rect.bottom().as_int(); ++y)
+                {
+                    std::fill_n(content.begin() + y * animated_size + rect.left().as_int(), rect.size.width.as_int(), colour);
+                }
+            }
+
+            wlcs::ShmBuffer buffer{animator, animated_size, animated_size};
+            std::memcpy(buffer.data().data(), content.data(), content.size() * sizeof(uint32_t));
+            wl_surface_attach(animated, buffer, 0, 0);
+            for (auto const& rect : rects)
+            {
+                wl_surface_damage_buffer(
+                    animated,
+                    rect.left().as_int(), rect.top().as_int(),
+                    rect.size.width.as_int(), rect.size.height.as_int());
+            }
+            wl_surface_commit(animated);
+            animator.advance_frame_clock();
+        };
+
+    // Get the whole surface drawn in our content, and captured in full
+    bool drawn{false};
+    animated.add_frame_callback([&drawn](auto) { drawn = true; });
+    redraw({{{0, 0}, {animated_size, animated_size}}});
+    animator.dispatch_until([&drawn]() { return drawn; });
+    capture();
+    wait_for_capture();
+
+    for (auto const& update : updates)
+    {
+        long expected_area{0};
+        for (auto const& rect : update.rects)
+        {
+            expected_area += area_of(in_capture(rect));
+        }
+
+        double reported_area{0}, changed_area{0};
+        int minimal_frames{0};
+        for (auto i = 0; i < frames_per_update; ++i)
+        {
+            capture();
+            redraw(update.rects);
+            wait_for_capture();
+
+            auto const diff = diff_captures(
+                wlcs::PixelView{previous_capture().data(), buffer_size},
+                wlcs::PixelView{latest_capture().data(), buffer_size},
+                frame->damage());
+
+            long area{0};
+            for (auto const& rect : frame->damage())
+            {
+                area += area_of(rect);
+            }
+            reported_area += area;
+            changed_area += diff.changed_pixels;
+            EXPECT_THAT(diff.undamaged_pixels, Eq(0))
+                << update.name << ": pixels changed within " << diff.bounds
+                << " outside the reported damage " << PrintToString(frame->damage());
+            if (diff.changed_pixels > 0 && area == diff.changed_pixels)
+            {
+                ++minimal_frames;
+            }
+        }
+
+        auto const name = std::format("damage.{}", update.name);
+        wlcs::report_benchmark(name + ".expected_area", static_cast<double>(expected_area), "pixels");
+        wlcs::report_benchmark(name + ".changed_area", changed_area / frames_per_update, "pixels");
+        wlcs::report_benchmark(name + ".reported_area", reported_area / frames_per_update, "pixels");
+        wlcs::report_benchmark(
+            name + ".over_report", changed_area > 0 ? reported_area / changed_area : 0.0, "times_changed");
+        wlcs::report_benchmark(name + ".minimal_frames", 100.0 * minimal_frames / frames_per_update, "percent");
     }
 }
 
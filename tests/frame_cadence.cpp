@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Frame callback cadence benchmark
+ *
+ * Drives a surface through commit → wl_surface.frame → wl_callback.done
+ * cycles, as fast as the compositor's frame callbacks allow, and reports
+ * how evenly paced those callbacks are.
+ */
+
+#include "benchmark.h"
+#include "in_process_server.h"
+#include "shm_buffer_ring.h"
+
+#include <gmock/gmock.h>
+
+#include <limits>
+#include <optional>
+
+using namespace testing;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+int const warmup_frames = 10;
+int const frames = 1000;
+int const surface_width = 200, surface_height = 200;
+
+struct FrameCadenceBenchmark : wlcs::StartedInProcessServer
+{
+    wlcs::Client client{the_server()};
+    wlcs::Surface surface{client.create_visible_surface(surface_width, surface_height)};
+
+    wlcs::ShmBufferRing buffers{client, surface_width, surface_height};
+};
+}
+
+TEST_F(FrameCadenceBenchmark, commit_frame_callback_cycle)
+{
+    wlcs::DurationSamples commit_to_callback;
+    wlcs::DurationSamples callback_interval;
+    wlcs::DurationSamples frame_time_interval;
+
+    std::optional<Clock::time_point> first_callback, previous_callback;
+    std::optional<uint32_t> previous_frame_time;
+
+    for (auto i = 0; i < warmup_frames + frames; ++i)
+    {
+        auto const measuring = i >= warmup_frames;
+
+        std::optional<Clock::time_point> callback_time;
+        uint32_t frame_time{0};
+        surface.add_frame_callback(
+            [&](int time)
+            {
+                callback_time = Clock::now();
+                frame_time = time;
+            });
+
+        wl_surface_attach(surface, buffers.acquire_when_free(), 0, 0);
+        wl_surface_damage(surface, 0, 0, surface_width, surface_height);
+        auto const committed = Clock::now();
+        wl_surface_commit(surface);
+
+        client.dispatch_until([&]() { return callback_time.has_value(); });
+
+        if (measuring)
+        {
+            commit_to_callback.add(*callback_time - committed);
+            if (previous_callback)
+            {
+                callback_interval.add(*callback_time - *previous_callback);
+            }
+            if (previous_frame_time)
+            {
+                // frame_time is a millisecond timestamp that may wrap; unsigned arithmetic copes
+                uint32_t const interval = frame_time - *previous_frame_time;
+                EXPECT_THAT(interval, Lt(std::numeric_limits<uint32_t>::max() / 2))
+                    << "Frame callback time went backwards";
+                frame_time_interval.add(std::chrono::milliseconds{interval});
+            }
+            if (!first_callback)
+            {
+                first_callback = callback_time;
+            }
+            previous_callback = callback_time;
+            previous_frame_time = frame_time;
+        }
+    }
+
+    auto const elapsed = std::chrono::duration<double>(*previous_callback - *first_callback);
+    wlcs::report_benchmark("frame_callback_rate", (frames - 1) / elapsed.count(), "fps");
+    wlcs::report_benchmark("frame_callback_interval", callback_interval);
+    wlcs::report_benchmark(
+        "frame_callback_jitter",
+        std::chrono::duration<double, std::micro>{callback_interval.standard_deviation()}.count(),
+        "us");
+    wlcs::report_benchmark("commit_to_frame_callback", commit_to_callback);
+    wlcs::report_benchmark("compositor_frame_time_interval", frame_time_interval);
+}
@@ -0,0 +1,300 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Input latency benchmarks
+ *
+ * Each sample is the time from the start of injecting an event through a
+ * wlcs::Pointer, wlcs::Touch or wlcs::Keyboard to the client receiving the
+ * corresponding wl_pointer.motion, wl_touch.down or wl_keyboard.key. This
+ * includes the cost of calling into the integration, so compare results
+ * between compositor releases rather than treating them as absolute.
+ *
+ * Where the integration accepts timestamps for injected input, and the
+ * compositor uses them as the time of the events it sends, pointer and
+ * keyboard latency are also broken down into injection (reaching the
+ * integration), compositor (within the integration's hook) and delivery
+ * (from the hook returning to the client receiving the event) segments.
+ */
+
+#include "benchmark.h"
+#include "in_process_server.h"
+
+#include <gmock/gmock.h>
+#include <linux/input-event-codes.h>
+
+#include <optional>
+#include <string>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace testing;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Samples taken before measuring, to get the compositor past any first-use costs
+int const warmup_samples = 10;
+int const samples = 250;
+
+/*
+ * Timestamps the arrival of wl_pointer.motion, wl_touch.down or wl_keyboard.key
+ *
+ * This uses its own wl_pointer, wl_touch or wl_keyboard so that the timestamp
+ * is taken as soon as libwayland dispatches the event, rather than at the end
+ * of the frame. The seat must already have the corresponding capability.
+ */
+class InputArrivalTimer
+{
+public:
+    enum class Device
+    {
+        pointer,
+        touch,
+        keyboard
+    };
+
+    InputArrivalTimer(wl_seat* seat, Device device)
+        : proxy{create_listening_proxy(seat, device)}
+    {
+    }
+
+    ~InputArrivalTimer()
+    {
+        wl_proxy_destroy(proxy);
+    }
+
+    /**
+     * Call \p inject, and measure how long it takes for the event to reach \p client
+     */
+    template<typename Inject>
+    auto time(wlcs::Client& client, Inject const& inject) -> wlcs::DurationSamples::Duration
+    {
+        arrived.reset();
+        auto const sent = Clock::now();
+        inject();
+        client.dispatch_until([this]() { return arrived.has_value(); });
+        return std::chrono::duration_cast<wlcs::DurationSamples::Duration>(*arrived - sent);
+    }
+
+private:
+    auto create_listening_proxy(wl_seat* seat, Device device) -> wl_proxy*
+    {
+        static wl_pointer_listener const pointer_listener = {
+            [](auto...){},  // enter
+            [](auto...){},  // leave
+            [](void* data, wl_pointer*, uint32_t, wl_fixed_t, wl_fixed_t)
+            {
+                static_cast<InputArrivalTimer*>(data)->arrived = Clock::now();
+            },
+            [](auto...){},  // button
+            [](auto...){},  // axis
+            [](auto...){},  // frame
+            [](auto...){},  // axis_source
+            [](auto...){},  // axis_stop
+            [](auto...){},  // axis_discrete
+            [](auto...){},  // axis_value120
+            [](auto...){},  // axis_relative_direction
+        };
+        static wl_touch_listener const touch_listener = {
+            [](void* data, wl_touch*, uint32_t, uint32_t, wl_surface*, int32_t, wl_fixed_t, wl_fixed_t)
+            {
+                static_cast<InputArrivalTimer*>(data)->arrived = Clock::now();
+            },
+            [](auto...){},  // up
+            [](auto...){},  // motion
+            [](auto...){},  // frame
+            [](auto...){},  // cancel
+            [](auto...){},  // shape
+            [](auto...){},  // orientation
+        };
+        static wl_keyboard_listener const keyboard_listener = {
+            [](void*, wl_keyboard*, uint32_t, int32_t fd, uint32_t) { close(fd); },
+            [](auto...){},  // enter
+            [](auto...){},  // leave
+            [](void* data, wl_keyboard*, uint32_t, uint32_t, uint32_t, uint32_t)
+            {
+                static_cast<InputArrivalTimer*>(data)->arrived = Clock::now();
+            },
+            [](auto...){},  // modifiers
+            [](auto...){},  // repeat_info
+        };
+
+        switch (device)
+        {
+        case Device::pointer:
+        {
+            auto const pointer = wl_seat_get_pointer(seat);
+            wl_pointer_add_listener(pointer, &pointer_listener, this);
+            return reinterpret_cast<wl_proxy*>(pointer);
+        }
+        case Device::touch:
+        {
+            auto const touch = wl_seat_get_touch(seat);
+            wl_touch_add_listener(touch, &touch_listener, this);
+            return reinterpret_cast<wl_proxy*>(touch);
+        }
+        case Device::keyboard:
+        {
+            auto const keyboard = wl_seat_get_keyboard(seat);
+            wl_keyboard_add_listener(keyboard, &keyboard_listener, this);
+            return reinterpret_cast<wl_proxy*>(keyboard);
+        }
+        }
+        throw std::logic_error{"Unknown input device"};
+    }
+
+    wl_proxy* const proxy;
+    std::optional<Clock::time_point> arrived;
+};
+
+struct Latency
+{
+    wlcs::DurationSamples total;
+    // Only filled in if the injected input can be traced to the client's event
+    wlcs::DurationSamples injection;
+    wlcs::DurationSamples compositor;
+    wlcs::DurationSamples delivery;
+};
+
+void report_latency(std::string const& name, Latency const& latency)
+{
+    wlcs::report_benchmark(name + "_latency", latency.total);
+    if (latency.injection.count() > 0)
+    {
+        wlcs::report_benchmark(name + "_injection", latency.injection);
+        wlcs::report_benchmark(name + "_compositor", latency.compositor);
+        wlcs::report_benchmark(name + "_delivery", latency.delivery);
+    }
+}
+
+auto no_timing() -> std::optional<wlcs::InputTiming>
+{
+    return {};
+}
+
+struct InputLatencyBenchmark : wlcs::StartedInProcessServer
+{
+    int const surface_x = 100, surface_y = 100;
+    int const surface_width = 300, surface_height = 300;
+
+    wlcs::Client client{the_server()};
+    wlcs::Surface surface{client.create_visible_surface(surface_width, surface_height)};
+
+    InputLatencyBenchmark()
+    {
+        the_server().move_surface_to(surface, surface_x, surface_y);
+    }
+
+    /**
+     * Time \p inject for each sample, calling \p reset (untimed) after each
+     *
+     * \p timing fetches the breakdown of the latest sample, if there is one
+     */
+    template<typename Inject, typename Reset, typename Timing>
+    auto measure(
+        InputArrivalTimer::Device device,
+        Inject const& inject,
+        Reset const& reset,
+        Timing const& timing) -> Latency
+    {
+        // Make sure the seat has advertised the device's capability before we bind it
+        client.roundtrip();
+        InputArrivalTimer timer{client.seat(), device};
+        client.roundtrip();
+
+        Latency result;
+        for (auto i = 0; i < warmup_samples + samples; ++i)
+        {
+            auto const latency = timer.time(client, [&]() { inject(i); });
+            if (i >= warmup_samples)
+            {
+                result.total.add(latency);
+                if (auto const stages = timing())
+                {
+                    result.injection.add(stages->dispatched - stages->injected);
+                    result.compositor.add(stages->processed - stages->dispatched);
+                    result.delivery.add(stages->received - stages->processed);
+                }
+            }
+            reset();
+        }
+        return result;
+    }
+};
+}
+
+TEST_F(InputLatencyBenchmark, pointer_motion)
+{
+    auto pointer = the_server().create_pointer();
+    pointer.move_to(surface_x + surface_width / 2, surface_y + surface_height / 2);
+    client.roundtrip();
+    ASSERT_THAT(client.window_under_cursor(), Eq(static_cast<wl_surface*>(surface)));
+
+    auto const latency = measure(
+        InputArrivalTimer::Device::pointer,
+        [&](int i)
+        {
+            // Jiggle back and forth, so we never leave the surface
+            pointer.move_by(i % 2 ? -1 : 1, 0);
+        },
+        []() {},
+        [&]() { return client.last_pointer_motion_timing(); });
+
+    report_latency("pointer_motion", latency);
+}
+
+TEST_F(InputLatencyBenchmark, touch_down)
+{
+    auto touch = the_server().create_touch();
+    int const touch_x = surface_x + surface_width / 2, touch_y = surface_y + surface_height / 2;
+
+    auto const latency = measure(
+        InputArrivalTimer::Device::touch,
+        [&](int) { touch.down_at(touch_x, touch_y); },
+        [&]()
+        {
+            touch.up();
+            client.roundtrip();
+        },
+        no_timing);
+
+    report_latency("touch_down", latency);
+}
+
+TEST_F(InputLatencyBenchmark, keyboard_key)
+{
+    auto pointer = the_server().create_pointer();
+    auto keyboard = the_server().create_keyboard();
+
+    pointer.move_to(surface_x + surface_width / 2, surface_y + surface_height / 2);
+    pointer.left_click();
+    client.roundtrip();
+    ASSERT_THAT(client.keyboard_focused_window(), Eq(static_cast<wl_surface*>(surface)));
+
+    auto const latency = measure(
+        InputArrivalTimer::Device::keyboard,
+        [&](int) { keyboard.key_down(KEY_A); },
+        [&]()
+        {
+            keyboard.key_up(KEY_A);
+            client.roundtrip();
+        },
+        [&]() { return client.last_key_timing(); });
+
+    report_latency("keyboard_key", latency);
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Many-clients scalability benchmark
+ *
+ * Ramps the number of connected clients, each showing a visible surface, in
+ * powers of two up to several thousand. At each step it measures, with that
+ * many clients already connected:
+ *  - how long a new connection takes to become live,
+ *  - how long that connection takes to enumerate the registry,
+ *  - how long a new client's first frame callback takes,
+ *  - how long a round trip to every client at once takes, and
+ *  - how much the process's RSS grows per client.
+ * It then reports the client count at which each per-client cost first
+ * doubles from its single-client value; where the curve bends.
+ *
+ * The compositor runs in the wlcs process, so the RSS figure covers both
+ * the wlcs and the compositor side of each client.
+ */
+
+#include "benchmark.h"
+#include "in_process_server.h"
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace testing;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+int const max_clients = 4096;
+int const probes_per_step = 10;
+// Small surfaces, so that buffer allocation doesn't dominate the per-client cost
+int const surface_size = 32;
+
+auto resident_set_kib() -> long
+{
+    std::ifstream statm{"/proc/self/statm"};
+    long size{0}, resident{0};
+    statm >> size >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/*
+ * Raise our fd limit as far as we're allowed, and work out how many
+ * clients we can then afford
+ *
+ * The caller should restore the limit afterwards, so later tests run as usual.
+ */
+auto affordable_client_count(int wanted) -> int
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur == RLIM_INFINITY)
+    {
+        return wanted;
+    }
+
+    /* An in-process client has an fd at each end of its socket, plus transient shm and keymap
+     * fds, and two more if --count-wire-traffic relays its connection
+     */
+    long const fds_per_client = 6;
+    long const reserved_fds = 256;
+    return std::clamp<long>((static_cast<long>(limit.rlim_cur) - reserved_fds) / fds_per_client, 1, wanted);
+}
+
+struct Step
+{
+    int clients;
+    wlcs::DurationSamples connect;
+    wlcs::DurationSamples registry;
+    wlcs::DurationSamples first_frame;
+};
+
+/*
+ * The client count at which the median of a per-client cost first reaches
+ * double its value at the first step, if it does
+ */
+template<typename Metric>
+auto knee(std::vector<Step> const& steps, Metric const& metric) -> std::optional<int>
+{
+    auto const baseline = metric(steps.front()).percentile(50);
+    for (auto const& step : steps)
+    {
+        if (metric(step).percentile(50) >= 2 * baseline)
+        {
+            return step.clients;
+        }
+    }
+    return {};
+}
+
+/*
+ * A connection with no globals bound, and no wlcs::Client machinery
+ */
+struct RawConnection
+{
+    explicit RawConnection(int fd)
+        : display{wl_display_connect_to_fd(fd)}
+    {
+    }
+
+    ~RawConnection()
+    {
+        if (registry)
+        {
+            wl_registry_destroy(registry);
+        }
+        if (display)
+        {
+            wl_display_disconnect(display);
+        }
+    }
+
+    RawConnection(RawConnection const&) = delete;
+    auto operator=(RawConnection const&) -> RawConnection& = delete;
+
+    wl_display* const display;
+    wl_registry* registry{nullptr};
+};
+
+struct ManyClientsBenchmark : wlcs::StartedInProcessServer
+{
+    ManyClientsBenchmark()
+    {
+        if (getrlimit(RLIMIT_NOFILE, &original_fd_limit) == 0)
+        {
+            restore_fd_limit = true;
+        }
+    }
+
+    ~ManyClientsBenchmark()
+    {
+        if (restore_fd_limit)
+        {
+            setrlimit(RLIMIT_NOFILE, &original_fd_limit);
+        }
+    }
+
+    /*
+     * Time a raw connection becoming live and then enumerating the registry
+     */
+    void probe_connection(Step& step)
+    {
+        static wl_registry_listener const registry_listener{
+            [](void*, wl_registry*, uint32_t, char const*, uint32_t) {},
+            [](void*, wl_registry*, uint32_t) {}
+        };
+
+        auto const start = Clock::now();
+        RawConnection connection{the_server().create_client_socket()};
+        ASSERT_THAT(connection.display, NotNull());
+        ASSERT_THAT(wl_display_roundtrip(connection.display), Ge(0));
+        auto const connected = Clock::now();
+
+        connection.registry = wl_display_get_registry(connection.display);
+        wl_registry_add_listener(connection.registry, &registry_listener, nullptr);
+        ASSERT_THAT(wl_display_roundtrip(connection.display), Ge(0));
+        auto const enumerated = Clock::now();
+
+        step.connect.add(connected - start);
+        step.registry.add(enumerated - connected);
+    }
+
+    /*
+     * Time a new client's first surface becoming visible
+     */
+    void probe_first_frame(Step& step)
+    {
+        wlcs::Client client{the_server()};
+        auto const start = Clock::now();
+        auto const surface = client.create_visible_surface(surface_size, surface_size);
+        step.first_frame.add(Clock::now() - start);
+    }
+
+private:
+    rlimit original_fd_limit;
+    bool restore_fd_limit{false};
+};
+}
+
+TEST_F(ManyClientsBenchmark, ramp_connected_clients)
+{
+    // RLIMIT_NOFILE may not allow max_clients; the max_clients result records how many we reached
+    auto const client_limit = affordable_client_count(max_clients);
+
+    std::vector<std::unique_ptr<wlcs::Client>> clients;
+    std::vector<wlcs::Surface> surfaces;
+    wlcs::Dispatcher dispatcher;
+    std::vector<Step> steps;
+
+    for (auto target = 1; target <= client_limit; target *= 2)
+    {
+        Step step{target, {}, {}, {}};
+
+        auto const rss_before = resident_set_kib();
+        auto const added = target - static_cast<int>(clients.size());
+        while (static_cast<int>(clients.size()) < target)
+        {
+            clients.push_back(std::make_unique<wlcs::Client>(the_server()));
+            dispatcher.add(*clients.back());
+            surfaces.push_back(clients.back()->create_visible_surface(surface_size, surface_size));
+        }
+        auto const rss_per_client = static_cast<double>(resident_set_kib() - rss_before) / added;
+
+        auto const roundtrip_start = Clock::now();
+        dispatcher.roundtrip();
+        auto const roundtrip_all = Clock::now() - roundtrip_start;
+
+        // Probe every metric as often at every step, so each has a real median
+        for (auto i = 0; i < probes_per_step; ++i)
+        {
+            ASSERT_NO_FATAL_FAILURE(probe_connection(step));
+            probe_first_frame(step);
+        }
+
+        auto const prefix = std::format("clients_{}", target);
+        wlcs::report_benchmark(prefix + ".connect", step.connect);
+        wlcs::report_benchmark(prefix + ".registry", step.registry);
+        wlcs::report_benchmark(prefix + ".first_frame", step.first_frame);
+        wlcs::report_benchmark(
+            prefix + ".roundtrip_all",
+            std::chrono::duration<double, std::micro>{roundtrip_all}.count(),
+            "us");
+        wlcs::report_benchmark(prefix + ".rss_per_client", rss_per_client, "kib");
+
+        steps.push_back(std::move(step));
+    }
+
+    wlcs::report_benchmark("max_clients", clients.size(), "clients");
+    auto const report_knee =
+        [&steps](std::string const& name, auto const& metric)
+        {
+            if (auto const clients = knee(steps, metric))
+            {
+                wlcs::report_benchmark(name + "_knee", *clients, "clients");
+            }
+            else
+            {
+                // Under the same name as a knee would be, so reports show there was none
+                ::testing::Test::RecordProperty(name + "_knee.clients", "none");
+            }
+        };
+    report_knee("connect", [](Step const& step) -> auto const& { return step.connect; });
+    report_knee("registry", [](Step const& step) -> auto const& { return step.registry; });
+    report_knee("first_frame", [](Step const& step) -> auto const& { return step.first_frame; });
+
+    // Make sure every client survived
+    dispatcher.roundtrip();
+}
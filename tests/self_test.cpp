@@ -20,11 +20,18 @@
 #include "helpers.h"
 #include "gtest_helpers.h"
 #include "in_process_server.h"
+#include "pixel_kernels.h"
 #include "version_specifier.h"
 
 #include <gmock/gmock.h>
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <optional>
+#include <vector>
+
+#include <endian.h>
 
 using namespace testing;
 using namespace wlcs;
@@ -69,6 +76,14 @@ TEST_F(SelfTest, when_a_client_creates_a_surface_nothing_bad_happens)
     client1.roundtrip();
 }
 
+TEST_F(SelfTest, when_a_client_creates_many_surfaces_at_once_nothing_bad_happens)
+{
+    auto const surfaces{client1.create_visible_surfaces(10, any_width, any_height)};
+    client1.roundtrip();
+
+    EXPECT_THAT(surfaces.size(), Eq(10u));
+}
+
 TEST_F(SelfTest, given_second_client_when_first_creates_a_surface_nothing_bad_happens)
 {
     Client client2{the_server()};
@@ -213,3 +228,328 @@ TEST_F(SelfTest, dispatch_until_times_out_at_the_right_time)
     }
     FAIL() << "Dispatch did not raise a wlcs::Timeout exception";
 }
+
+TEST_F(SelfTest, batched_pointer_motion_is_delivered_in_order)
+{
+    int const surface_x = 100, surface_y = 100;
+
+    auto surface = client1.create_visible_surface(any_width, any_height);
+    the_server().move_surface_to(surface, surface_x, surface_y);
+
+    auto pointer = the_server().create_pointer();
+    pointer.move_to(surface_x + 1, surface_y + 1);
+    client1.roundtrip();
+    ASSERT_THAT(client1.window_under_cursor(), Eq(static_cast<wl_surface*>(surface)));
+
+    the_server().begin_input_batch();
+    for (auto i = 0; i != 500; ++i)
+    {
+        pointer.move_by(i % 2 ? 1 : -1, 0);
+    }
+    pointer.move_to(surface_x + 30, surface_y + 40);
+    the_server().flush_input();
+
+    client1.roundtrip();
+    EXPECT_THAT(client1.window_under_cursor(), Eq(static_cast<wl_surface*>(surface)));
+    EXPECT_THAT(client1.pointer_position(), Eq(std::make_pair(wl_fixed_from_int(30), wl_fixed_from_int(40))));
+}
+
+TEST_F(SelfTest, injected_pointer_batch_is_delivered_in_order)
+{
+    int const surface_x = 100, surface_y = 100;
+
+    auto surface = client1.create_visible_surface(any_width, any_height);
+    the_server().move_surface_to(surface, surface_x, surface_y);
+
+    auto pointer = the_server().create_pointer();
+    pointer.move_to(surface_x + 1, surface_y + 1);
+    client1.roundtrip();
+    ASSERT_THAT(client1.window_under_cursor(), Eq(static_cast<wl_surface*>(surface)));
+
+    // A 1kHz trace, ending at a known position
+    auto time = std::chrono::steady_clock::now();
+    std::vector<PointerEvent> events;
+    for (auto i = 0; i != 500; ++i)
+    {
+        events.push_back({PointerEvent::Type::move_by, time, i % 2 ? 1 : -1, 0});
+        time += std::chrono::milliseconds{1};
+    }
+    events.push_back({PointerEvent::Type::move_to, time, surface_x + 30, surface_y + 40});
+    pointer.inject_batch(events);
+
+    client1.roundtrip();
+    EXPECT_THAT(client1.window_under_cursor(), Eq(static_cast<wl_surface*>(surface)));
+    EXPECT_THAT(client1.pointer_position(), Eq(std::make_pair(wl_fixed_from_int(30), wl_fixed_from_int(40))));
+}
+
+TEST_F(SelfTest, dispatcher_waits_on_many_clients_at_once)
+{
+    int const client_count = 50;
+
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<Surface> surfaces;
+    Dispatcher dispatcher;
+    for (auto i = 0; i != client_count; ++i)
+    {
+        clients.push_back(std::make_unique<Client>(the_server()));
+        dispatcher.add(*clients.back());
+    }
+
+    int frames_done = 0;
+    for (auto const& client : clients)
+    {
+        surfaces.push_back(client->create_visible_surface(any_width, any_height));
+        surfaces.back().attach_buffer(any_width, any_height);
+        surfaces.back().add_frame_callback([&frames_done](int) { ++frames_done; });
+        wl_surface_commit(surfaces.back());
+    }
+
+    dispatcher.dispatch_until([&]() { return frames_done == client_count; });
+    dispatcher.roundtrip();
+
+    for (auto const& client : clients)
+    {
+        dispatcher.remove(*client);
+    }
+}
+
+TEST_F(SelfTest, recycled_shm_buffers_are_zero_filled)
+{
+    // A size no other buffer in this test has, so the pool can only hand back our dirty buffer
+    int const width = any_width * 2, height = any_height * 2;
+
+    Client client{the_server()};
+    auto surface = client.create_visible_surface(any_width, any_height);
+
+    auto released = false;
+    std::optional<ShmBuffer> buffer{std::in_place, client, width, height};
+    buffer->add_release_listener([&released]() { released = true; return false; });
+    std::ranges::fill(buffer->data(), std::byte{0xff});
+    wl_buffer* const first = *buffer;
+    wl_surface_attach(surface, first, 0, 0);
+    wl_surface_commit(surface);
+
+    // Replacing the buffer should get the compositor to release the first
+    surface.attach_visible_buffer(any_width, any_height);
+    client.dispatch_until([&released]() { return released; });
+    buffer.reset();
+
+    ShmBuffer reused{client, width, height};
+    ASSERT_THAT(static_cast<wl_buffer*>(reused), Eq(first));
+    EXPECT_THAT(std::ranges::count(reused.data(), std::byte{0}), Eq(std::ssize(reused.data())));
+}
+
+TEST_F(SelfTest, shm_buffer_released_before_it_is_destroyed_is_reused)
+{
+    // A size no other buffer in this test has, so the pool could only hand back our buffer
+    int const width = any_width * 4, height = any_height * 4;
+
+    Client client{the_server()};
+    auto surface = client.create_visible_surface(any_width, any_height);
+
+    auto released = false;
+    std::optional<ShmBuffer> buffer{std::in_place, client, width, height};
+    buffer->add_release_listener([&released]() { released = true; return false; });
+    wl_buffer* const first = *buffer;
+    wl_surface_attach(surface, first, 0, 0);
+    wl_surface_commit(surface);
+
+    surface.attach_visible_buffer(any_width, any_height);
+    client.dispatch_until([&released]() { return released; });
+    buffer.reset();
+
+    ShmBuffer next{client, width, height};
+    EXPECT_THAT(static_cast<wl_buffer*>(next), Eq(first));
+}
+
+TEST_F(SelfTest, shm_buffer_never_handed_out_is_reused)
+{
+    // A size no other buffer in this test has, so the pool could only hand back our buffer
+    int const width = any_width * 5, height = any_height * 5;
+
+    Client client{the_server()};
+
+    std::optional<ShmBuffer> buffer{std::in_place, client, width, height};
+    // Asking for its wl_buffer would hand it out, so tell it by its memory instead
+    auto const first = buffer->data().data();
+    buffer.reset();
+
+    ShmBuffer next{client, width, height};
+    EXPECT_THAT(next.data().data(), Eq(first));
+}
+
+TEST_F(SelfTest, shm_buffer_attached_again_after_release_is_not_reused_while_attached)
+{
+    // A size no other buffer in this test has, so the pool could only hand back our buffer
+    int const width = any_width * 3, height = any_height * 3;
+
+    Client client{the_server()};
+    auto surface = client.create_visible_surface(any_width, any_height);
+
+    auto released = false;
+    std::optional<ShmBuffer> buffer{std::in_place, client, width, height};
+    wl_buffer* const first = *buffer;
+    buffer->add_release_listener([&released]() { released = true; return true; });
+    wl_surface_attach(surface, *buffer, 0, 0);
+    wl_surface_commit(surface);
+
+    surface.attach_visible_buffer(any_width, any_height);
+    client.dispatch_until([&released]() { return released; });
+
+    // Now the compositor holds it again, despite the earlier release
+    wl_surface_attach(surface, *buffer, 0, 0);
+    wl_surface_commit(surface);
+    client.roundtrip();
+    buffer.reset();
+
+    ShmBuffer next{client, width, height};
+    EXPECT_THAT(static_cast<wl_buffer*>(next), Ne(first));
+}
+
+TEST_F(SelfTest, advancing_the_frame_clock_sends_frame_callbacks)
+{
+    if (!the_server().supports_frame_clock())
+    {
+        ::testing::Test::RecordProperty("wlcs-skip-test", "Compositor Integration module does not support advancing the frame clock");
+        FAIL() << "Requires unsupported feature from module under test";
+    }
+
+    Client client{the_server()};
+    auto surface = client.create_visible_surface(any_width, any_height);
+
+    auto frame_done = false;
+    surface.add_frame_callback([&frame_done](int) { frame_done = true; });
+    wl_surface_commit(surface);
+
+    client.advance_frame_clock();
+    // The frame callback was queued before the server handles our roundtrip
+    client.roundtrip();
+
+    EXPECT_THAT(frame_done, Eq(true));
+}
+
+namespace
+{
+/*
+ * An image with a stride wider than its rows, and rows that are not a whole
+ * number of SIMD registers wide, so every kernel runs a vector loop and a tail
+ */
+struct TestImage
+{
+    static constexpr int width = 37;
+    static constexpr int height = 5;
+    static constexpr int stride = 40 * 4;
+
+    explicit TestImage(uint32_t colour)
+        : bytes(stride * height, std::byte{0x5a})
+    {
+        for (auto y = 0; y < height; ++y)
+        {
+            for (auto x = 0; x < width; ++x)
+            {
+                set(x, y, colour);
+            }
+        }
+    }
+
+    void set(int x, int y, uint32_t colour)
+    {
+        auto const little_endian = htole32(colour);
+        std::memcpy(bytes.data() + y * stride + x * 4, &little_endian, sizeof little_endian);
+    }
+
+    auto view(PixelFormat format = PixelFormat::argb8888) const -> PixelView
+    {
+        return PixelView{bytes, Size{width, height}, stride, format};
+    }
+
+    std::vector<std::byte> bytes;
+};
+
+uint32_t const any_colour = 0xff102030;
+}
+
+TEST_F(SelfTest, pixel_checks_spot_a_single_odd_pixel)
+{
+    TestImage image{any_colour};
+    // The last pixel is only reached by the scalar tail of a vector kernel
+    image.set(TestImage::width - 1, TestImage::height - 1, any_colour ^ 0x00000100);
+    TestImage const same{any_colour};
+
+    std::vector<uint64_t> checksums;
+    for (auto const kernels : supported_pixel_kernels())
+    {
+        SCOPED_TRACE(kernels->name);
+        EXPECT_THAT(is_solid_fill(same.view(), any_colour, *kernels), IsTrue());
+        EXPECT_THAT(is_solid_fill(image.view(), any_colour, *kernels), IsFalse());
+        EXPECT_THAT(pixels_match(image.view(), same.view(), 0, *kernels), IsFalse());
+        EXPECT_THAT(pixels_match(image.view(), same.view(), 1, *kernels), IsTrue());
+        EXPECT_THAT(pixel_checksum(image.view(), *kernels), Ne(pixel_checksum(same.view(), *kernels)));
+        checksums.push_back(pixel_checksum(image.view(), *kernels));
+    }
+    EXPECT_THAT(checksums, Each(Eq(checksums.front())));
+}
+
+TEST_F(SelfTest, pixel_checks_ignore_alpha_of_xrgb8888)
+{
+    TestImage image{any_colour};
+    image.set(3, 2, any_colour & 0x00ffffff);
+    TestImage const same{any_colour};
+
+    std::vector<uint64_t> checksums;
+    for (auto const kernels : supported_pixel_kernels())
+    {
+        SCOPED_TRACE(kernels->name);
+        EXPECT_THAT(is_solid_fill(image.view(), any_colour, *kernels), IsFalse());
+        EXPECT_THAT(is_solid_fill(image.view(PixelFormat::xrgb8888), any_colour, *kernels), IsTrue());
+        EXPECT_THAT(pixels_match(image.view(PixelFormat::xrgb8888), same.view(), 0, *kernels), IsTrue());
+        EXPECT_THAT(
+            pixel_checksum(image.view(PixelFormat::xrgb8888), *kernels),
+            Eq(pixel_checksum(same.view(PixelFormat::xrgb8888), *kernels)));
+        checksums.push_back(pixel_checksum(image.view(PixelFormat::xrgb8888), *kernels));
+    }
+    EXPECT_THAT(checksums, Each(Eq(checksums.front())));
+}
+
+TEST_F(SelfTest, pixel_checksum_does_not_depend_on_stride)
+{
+    TestImage image{any_colour};
+    image.set(20, 1, 0xff000000);
+    image.set(36, 4, 0x12345678);
+
+    std::vector<std::byte> packed;
+    for (auto y = 0; y < TestImage::height; ++y)
+    {
+        auto const row = image.bytes.begin() + y * TestImage::stride;
+        packed.insert(packed.end(), row, row + TestImage::width * 4);
+    }
+    PixelView const packed_view{packed, Size{TestImage::width, TestImage::height}};
+
+    std::vector<uint64_t> checksums;
+    for (auto const kernels : supported_pixel_kernels())
+    {
+        SCOPED_TRACE(kernels->name);
+        EXPECT_THAT(pixel_checksum(packed_view, *kernels), Eq(pixel_checksum(image.view(), *kernels)));
+        EXPECT_THAT(pixels_match(packed_view, image.view(), 0, *kernels), IsTrue());
+        checksums.push_back(pixel_checksum(image.view(), *kernels));
+    }
+    EXPECT_THAT(checksums, Each(Eq(checksums.front())));
+}
+
+TEST_F(SelfTest, channel_histograms_count_every_pixel)
+{
+    TestImage image{any_colour};
+    image.set(0, 0, 0x80ff0001);
+
+    auto const histograms = channel_histograms(image.view());
+    auto const pixels = TestImage::width * TestImage::height;
+    EXPECT_THAT(histograms.alpha[0xff], Eq(pixels - 1));
+    EXPECT_THAT(histograms.alpha[0x80], Eq(1u));
+    EXPECT_THAT(histograms.red[0x10], Eq(pixels - 1));
+    EXPECT_THAT(histograms.red[0xff], Eq(1u));
+    EXPECT_THAT(histograms.green[0x20], Eq(pixels - 1));
+    EXPECT_THAT(histograms.blue[0x30], Eq(pixels - 1));
+    EXPECT_THAT(histograms.blue[0x01], Eq(1u));
+
+    EXPECT_THAT(channel_histograms(image.view(PixelFormat::xrgb8888)).alpha, Each(Eq(0u)));
+}
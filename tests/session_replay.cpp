@@ -0,0 +1,203 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Session replay benchmarks
+ *
+ * Replays recorded protocol sessions against the compositor as fast as it
+ * will take them, measuring how quickly it gets through a fixed, realistic
+ * request stream with no client-side work in the way.
+ */
+
+#include "benchmark.h"
+#include "helpers.h"
+#include "in_process_server.h"
+#include "session_replay.h"
+
+#include <boost/throw_exception.hpp>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+using namespace testing;
+namespace fs = std::filesystem;
+
+namespace
+{
+int const replays = 10;
+int const surfaces = 10;
+int const frames = 100;
+int const surface_width = 64, surface_height = 64;
+
+/*
+ * A directory that is removed, with its contents, at the end of the test
+ */
+struct TemporaryDirectory
+{
+    TemporaryDirectory()
+        : path{make()}
+    {
+    }
+
+    ~TemporaryDirectory()
+    {
+        std::error_code ignored;
+        fs::remove_all(path, ignored);
+    }
+
+    fs::path const path;
+
+private:
+    static auto make() -> fs::path
+    {
+        auto pattern = (fs::temp_directory_path() / "wlcs-sessions-XXXXXX").string();
+        if (!mkdtemp(pattern.data()))
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create temporary directory"}));
+        }
+        return pattern;
+    }
+};
+
+/*
+ * Wait for the recording of a disconnected client to be written
+ */
+auto wait_for_session_in(fs::path const& directory) -> fs::path
+{
+    auto const deadline = std::chrono::steady_clock::now() + wlcs::helpers::a_long_time();
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        for (auto const& entry : fs::directory_iterator{directory})
+        {
+            if (entry.path().extension() == ".wlsession")
+            {
+                return entry.path();
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    BOOST_THROW_EXCEPTION((wlcs::Timeout{"Timed out waiting for session recording"}));
+}
+
+/*
+ * Commits frames of buffers to a handful of role-less surfaces
+ *
+ * The session deliberately avoids anything, like xdg_surface.ack_configure,
+ * that echoes a compositor-chosen serial, as those would not be valid on
+ * replay.
+ */
+void run_scripted_session(wlcs::Server& server)
+{
+    wlcs::Client client{server};
+
+    std::vector<wlcs::Surface> scripted_surfaces;
+    std::vector<wlcs::ShmBuffer> buffers;
+    for (auto i = 0; i < surfaces; ++i)
+    {
+        scripted_surfaces.emplace_back(client);
+        buffers.emplace_back(client, surface_width, surface_height);
+    }
+
+    for (auto frame = 0; frame < frames; ++frame)
+    {
+        for (auto i = 0; i < surfaces; ++i)
+        {
+            wl_surface_attach(scripted_surfaces[i], buffers[i], 0, 0);
+            wl_surface_damage(scripted_surfaces[i], 0, 0, surface_width, surface_height);
+            wl_surface_commit(scripted_surfaces[i]);
+        }
+        wl_display_flush(client);
+    }
+    client.roundtrip();
+}
+
+void report_replay(std::string const& name, wlcs::ReplayResult const& result, wlcs::DurationSamples const& elapsed)
+{
+    auto const seconds = std::chrono::duration<double>{elapsed.mean()}.count();
+    wlcs::report_benchmark(name, elapsed);
+    wlcs::report_benchmark(name + ".requests", result.requests / seconds, "per_second");
+    wlcs::report_benchmark(name + ".request_bytes", result.request_bytes / seconds / 1e6, "MB_per_second");
+    wlcs::report_benchmark(name + ".event_bytes", result.event_bytes / seconds / 1e6, "MB_per_second");
+}
+
+struct SessionReplayBenchmark : wlcs::StartedInProcessServer
+{
+};
+}
+
+TEST_F(SessionReplayBenchmark, scripted_session)
+{
+    TemporaryDirectory const directory;
+
+    auto const previous_recording = wlcs::session_recording_directory();
+    wlcs::record_sessions_to(directory.path.string());
+    try
+    {
+        run_scripted_session(the_server());
+    }
+    catch (...)
+    {
+        wlcs::record_sessions_to(previous_recording);
+        throw;
+    }
+    wlcs::record_sessions_to(previous_recording);
+
+    auto const session = wait_for_session_in(directory.path);
+
+    wlcs::ReplayResult result;
+    wlcs::DurationSamples elapsed;
+    for (auto i = 0; i < replays; ++i)
+    {
+        result = wlcs::replay_session(the_server(), session.string());
+        elapsed.add(result.elapsed);
+    }
+
+    EXPECT_THAT(result.requests, Ge(surfaces * frames * 3));
+    report_replay("replay", result, elapsed);
+}
+
+TEST_F(SessionReplayBenchmark, recorded_sessions)
+{
+    auto const directory = wlcs::sessions_to_replay();
+    if (!directory)
+    {
+        ::testing::Test::RecordProperty("wlcs-skip-test", "No --replay-sessions directory given");
+        FAIL() << "No --replay-sessions directory given";
+    }
+
+    std::vector<fs::path> sessions;
+    for (auto const& entry : fs::directory_iterator{*directory})
+    {
+        if (entry.path().extension() == ".wlsession")
+        {
+            sessions.push_back(entry.path());
+        }
+    }
+    std::ranges::sort(sessions);
+    ASSERT_THAT(sessions, Not(IsEmpty())) << "No .wlsession files in " << *directory;
+
+    for (auto const& session : sessions)
+    {
+        wlcs::DurationSamples elapsed;
+        auto const result = wlcs::replay_session(the_server(), session.string());
+        elapsed.add(result.elapsed);
+        report_replay(session.stem().string(), result, elapsed);
+    }
+}
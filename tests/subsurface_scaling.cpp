@@ -0,0 +1,254 @@
+/*
+ * Copyright © 2026 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Subsurface tree scaling benchmark
+ *
+ * The performance companion to wl_subsurface.cpp. It grows a subsurface
+ * tree under a toplevel, either as a chain hundreds of levels deep or as
+ * thousands of siblings, and at each size measures:
+ *  - commit propagation: from committing a new buffer to a target
+ *    subsurface (and, in sync mode, each of its ancestors) to that buffer's
+ *    frame callback, in both sync and desync modes, and
+ *  - hit-testing: from moving the pointer onto the target to the client
+ *    seeing it enter the target.
+ * In a chain the target is the deepest subsurface; among siblings it is the
+ * bottom-most, beneath every other sibling.
+ */
+
+#include "benchmark.h"
+#include "in_process_server.h"
+
+#include <gmock/gmock.h>
+
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+int const max_depth = 256;
+int const max_width = 4096;
+int const samples_per_step = 20;
+
+int const surface_x = 100, surface_y = 100;
+int const surface_width = 200, surface_height = 200;
+int const subsurface_size = 16;
+// Somewhere on the toplevel, but clear of every subsurface
+int const clear_x = 150, clear_y = 150;
+// Where siblings other than the target go
+int const sibling_x = 100, sibling_y = 100;
+
+struct SubsurfaceScalingBenchmark : wlcs::StartedInProcessServer
+{
+    wlcs::Client client{the_server()};
+    wlcs::Surface surface{client.create_visible_surface(surface_width, surface_height)};
+    std::vector<std::unique_ptr<wlcs::Subsurface>> subsurfaces;
+
+    SubsurfaceScalingBenchmark()
+    {
+        the_server().move_surface_to(surface, surface_x, surface_y);
+    }
+
+    /*
+     * Extend the chain of subsurfaces to \p depth levels below the toplevel
+     */
+    void grow_chain(int depth)
+    {
+        while (static_cast<int>(subsurfaces.size()) < depth)
+        {
+            wlcs::Surface& parent = subsurfaces.empty() ? surface : *subsurfaces.back();
+            subsurfaces.push_back(std::make_unique<wlcs::Subsurface>(
+                wlcs::Subsurface::create_visible(parent, 0, 0, subsurface_size, subsurface_size)));
+        }
+    }
+
+    /*
+     * Add siblings until the toplevel has \p width subsurfaces
+     *
+     * Subsurface::create_visible() waits a frame for each subsurface, which
+     * would make thousands of siblings take minutes, so this commits all of
+     * this step's new siblings and then waits for one frame.
+     */
+    void grow_siblings(int width)
+    {
+        if (subsurfaces.empty())
+        {
+            subsurfaces.push_back(std::make_unique<wlcs::Subsurface>(
+                wlcs::Subsurface::create_visible(surface, 0, 0, subsurface_size, subsurface_size)));
+        }
+        if (static_cast<int>(subsurfaces.size()) >= width)
+        {
+            return;
+        }
+
+        while (static_cast<int>(subsurfaces.size()) < width)
+        {
+            auto& sibling = *subsurfaces.emplace_back(std::make_unique<wlcs::Subsurface>(surface));
+            wl_subsurface_set_position(sibling, sibling_x, sibling_y);
+            sibling.attach_buffer(subsurface_size, subsurface_size);
+            wl_surface_commit(sibling);
+        }
+
+        bool rendered{false};
+        surface.add_frame_callback([&rendered](auto) { rendered = true; });
+        wl_surface_commit(surface);
+        client.advance_frame_clock();
+        client.dispatch_until([&rendered]() { return rendered; });
+    }
+
+    auto target() -> wlcs::Subsurface&
+    {
+        return chain ? *subsurfaces.back() : *subsurfaces.front();
+    }
+
+    /*
+     * Time a new buffer on the target reaching the screen
+     *
+     * In sync mode the target's state is only applied when the toplevel is
+     * committed, so we commit every surface from the target up.
+     */
+    auto time_commit(bool sync) -> wlcs::DurationSamples::Duration
+    {
+        auto& subsurface = target();
+        subsurface.attach_buffer(subsurface_size, subsurface_size);
+        std::optional<Clock::time_point> rendered;
+        subsurface.add_frame_callback([&rendered](auto) { rendered = Clock::now(); });
+
+        auto const start = Clock::now();
+        wl_surface_commit(subsurface);
+        if (sync)
+        {
+            for (wlcs::Surface* ancestor = &subsurface.parent(); ancestor; )
+            {
+                wl_surface_commit(*ancestor);
+                auto const parent = dynamic_cast<wlcs::Subsurface*>(ancestor);
+                ancestor = parent ? &parent->parent() : nullptr;
+            }
+        }
+        client.advance_frame_clock();
+        client.dispatch_until([&rendered]() { return rendered.has_value(); });
+        return std::chrono::duration_cast<wlcs::DurationSamples::Duration>(*rendered - start);
+    }
+
+    /*
+     * Make the target and all its ancestors sync or desync
+     *
+     * A desync subsurface with a sync ancestor still behaves as sync.
+     */
+    void set_sync(bool sync)
+    {
+        for (wlcs::Surface* ancestor = &target(); auto const subsurface = dynamic_cast<wlcs::Subsurface*>(ancestor); )
+        {
+            if (sync)
+            {
+                wl_subsurface_set_sync(*subsurface);
+            }
+            else
+            {
+                wl_subsurface_set_desync(*subsurface);
+            }
+            ancestor = &subsurface->parent();
+        }
+    }
+
+    void measure_commits(std::string const& prefix)
+    {
+        wlcs::DurationSamples sync, desync;
+        for (auto i = 0; i < samples_per_step; ++i)
+        {
+            sync.add(time_commit(true));
+        }
+        set_sync(false);
+        for (auto i = 0; i < samples_per_step; ++i)
+        {
+            desync.add(time_commit(false));
+        }
+        set_sync(true);
+
+        wlcs::report_benchmark(prefix + ".sync_commit", sync);
+        wlcs::report_benchmark(prefix + ".desync_commit", desync);
+    }
+
+    void measure_hit_test(wlcs::Pointer& pointer, std::string const& prefix)
+    {
+        wl_surface* const target_surface = target();
+
+        wlcs::DurationSamples hit_test;
+        for (auto i = 0; i < samples_per_step; ++i)
+        {
+            pointer.move_to(surface_x + clear_x, surface_y + clear_y);
+            client.dispatch_until([&]() { return client.window_under_cursor() != target_surface; });
+
+            auto const start = Clock::now();
+            pointer.move_to(surface_x + subsurface_size / 2, surface_y + subsurface_size / 2);
+            client.dispatch_until([&]() { return client.window_under_cursor() == target_surface; });
+            hit_test.add(Clock::now() - start);
+        }
+
+        wlcs::report_benchmark(prefix + ".hit_test", hit_test);
+    }
+
+    // Whether we're growing a chain, rather than siblings
+    bool chain{true};
+};
+}
+
+TEST_F(SubsurfaceScalingBenchmark, deep_tree_commit)
+{
+    for (auto depth = 1; depth <= max_depth; depth *= 2)
+    {
+        grow_chain(depth);
+        measure_commits(std::format("depth_{}", depth));
+    }
+}
+
+TEST_F(SubsurfaceScalingBenchmark, wide_tree_commit)
+{
+    chain = false;
+    for (auto width = 1; width <= max_width; width *= 4)
+    {
+        grow_siblings(width);
+        measure_commits(std::format("width_{}", width));
+    }
+}
+
+TEST_F(SubsurfaceScalingBenchmark, deep_tree_hit_test)
+{
+    auto pointer = the_server().create_pointer();
+    for (auto depth = 1; depth <= max_depth; depth *= 2)
+    {
+        grow_chain(depth);
+        measure_hit_test(pointer, std::format("depth_{}", depth));
+    }
+}
+
+TEST_F(SubsurfaceScalingBenchmark, wide_tree_hit_test)
+{
+    chain = false;
+    auto pointer = the_server().create_pointer();
+    for (auto width = 1; width <= max_width; width *= 4)
+    {
+        grow_siblings(width);
+        measure_hit_test(pointer, std::format("width_{}", width));
+    }
+}
@@ -40,8 +40,14 @@ struct ShmTest : wlcs::StartedInProcessServer
 
 // A separate fixture, identical to ShmTest, used to spin up a second server
 // instance (see truncated_shm_file_is_an_error_on_a_second_server_instance).
+// This must never be handed a reset server from an earlier test.
 struct SecondShmTest : wlcs::StartedInProcessServer
 {
+    SecondShmTest()
+        : StartedInProcessServer{ServerInstance::fresh}
+    {
+    }
+
     wlcs::Client client{the_server()};
 };
 
@@ -57,6 +57,7 @@ void FrameSubmission::submit_frame(bool& consumed_flag)
 void FrameSubmission::wait_for_frame(bool const& consumed_flag)
 {
     // TODO timeout
+    client.advance_frame_clock();
     client.dispatch_until([&consumed_flag]() { return consumed_flag; });
 }
 }
@@ -164,5 +165,6 @@ TEST_F(FrameSubmission, frame_requests_without_buffer_are_called_back_eventually
         wl_surface_commit(surface);
     }
 
+    client.advance_frame_clock();
     client.dispatch_until([&called]() { return std::all_of(called.begin(), called.end(), [](bool value) { return value; }); });
 }
@@ -417,7 +417,7 @@ TEST_P(SurfaceInputCombinations, input_not_seen_in_region_after_null_buffer_comm
 
     auto const device = input->create_device(the_server());
     device->down_at(top_left);
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(wl_surface))
         << input << " seen by " << builder << " after null buffer committed";
@@ -443,7 +443,7 @@ TEST_P(SurfaceInputCombinations, input_not_seen_in_surface_without_region_after_
 
     auto const device = input->create_device(the_server());
     device->down_at(top_left);
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(wl_surface))
         << input << " seen by " << builder << " after null buffer committed";
@@ -472,7 +472,7 @@ TEST_P(SurfaceInputCombinations, input_not_seen_over_empty_region)
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first + 4, top_left.second + 4});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(wl_surface))
         << input << " seen by " << builder << " with empty input region";
@@ -505,7 +505,7 @@ TEST_P(SurfaceInputCombinations, input_hits_parent_after_falling_through_subsurf
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first + input_offset.first, top_left.second + input_offset.second});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(sub_wl_surface))
         << input << " seen by subsurface when not over region";
@@ -545,7 +545,7 @@ TEST_P(SurfaceInputCombinations, unmapping_parent_stops_subsurface_getting_input
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first + 4, top_left.second + 4});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(parent_wl_surface))
         << input << " seen by " << builder << " after it was unmapped";
@@ -587,7 +587,7 @@ TEST_P(SurfaceInputCombinations, input_falls_through_subsurface_when_unmapped)
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first - 90, top_left.second + 10});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(sub_wl_surface))
         << input << " seen by subsurface after it was unmapped";
@@ -632,7 +632,7 @@ TEST_P(SurfaceInputCombinations, input_falls_through_subsurface_when_parent_unma
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first - 90, top_left.second + 10});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(sub_wl_surface))
         << input << " seen by subsurface after parent was unmapped";
@@ -668,7 +668,7 @@ TEST_P(SurfaceInputCombinations, input_seen_after_surface_unmapped_and_remapped)
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first + input_offset.first, top_left.second + input_offset.second});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Eq(wl_surface))
         << input << " not seen by " << builder << " after it was unmapped and remapped";
@@ -711,7 +711,7 @@ TEST_P(SurfaceInputCombinations, input_seen_by_subsurface_after_parent_unmapped_
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first + input_offset.first, top_left.second + input_offset.second});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(parent_wl_surface))
         << input << " seen by " << builder << " when it should be seen by it's subsurface";
@@ -747,9 +747,9 @@ TEST_P(SurfaceInputCombinations, input_seen_after_dragged_off_surface)
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first + 5, top_left.second + 5});
-    client.roundtrip();
+    client.roundtrip_until_idle();
     device->move_to({top_left.first + input_offset.first, top_left.second + input_offset.second});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(other_wl_surface))
         << input << " seen by second surface event though it was dragged from first";
@@ -786,12 +786,12 @@ TEST_P(SurfaceInputCombinations, input_seen_by_second_surface_after_drag_off_fir
 
     auto const device = input->create_device(the_server());
     device->down_at({top_left.first + 5, top_left.second + 5});
-    client.roundtrip();
+    client.roundtrip_until_idle();
     device->move_to({top_left.first - 80, top_left.second + 5});
-    client.roundtrip();
+    client.roundtrip_until_idle();
     device->up();
     device->down_at({top_left.first - 80, top_left.second + 5});
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(main_wl_surface))
         << input << " seen by first " << builder << " after being up";
@@ -833,7 +833,7 @@ TEST_P(ToplevelInputCombinations, input_falls_through_surface_without_region_aft
 
     auto const device = input->create_device(the_server());
     device->down_at(top_left);
-    client.roundtrip();
+    client.roundtrip_until_idle();
 
     EXPECT_THAT(input->current_surface(client), Ne(upper_wl_surface))
         << input << " seen by " << builder << " after null buffer committed";